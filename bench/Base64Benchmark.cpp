@@ -0,0 +1,110 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Benchmark of the base64 codec against QByteArray
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <cstdio>
+#include <functional>
+#include <QtCore/QByteArray>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QRandomGenerator>
+#include <QtCore/QStringList>
+
+#include "api/utils/Base64Decoder.h"
+#include "api/utils/Base64Encoder.h"
+
+/*!
+ * \brief Run the operation enough times to take a measurable time and print a JSON line with the result
+ * \param name Benchmark name
+ * \param size Input size in bytes
+ * \param run Operation, returns its output size to keep it from being optimized out
+ */
+static void measure(const char *name, qint64 size, const std::function<int()> &run) {
+    auto repeats = qMax<qint64>(1, (qint64(256) << 20) / size);
+    qint64 checksum = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 i = 0; i < repeats; ++i) {
+        checksum += run();
+    }
+    auto nsecs = timer.nsecsElapsed();
+    printf(R"({"benchmark": "%s", "size": %lld, "repeats": %lld, "ns_per_op": %lld, "mb_per_s": %.1f, "output": %lld})"
+           "\n", name, size, repeats, nsecs / repeats, double(size) * repeats / 1e6 / (double(nsecs) / 1e9),
+           checksum / repeats);
+    fflush(stdout);
+}
+
+/*!
+ * \brief Compare the base64 codec with QByteArray::fromBase64() and QByteArray::toBase64()
+ * on inputs from 1 KB to 1 GB, or up to the size given in KB as the only argument
+ */
+int main(int argc, char **argv) {
+    qint64 maxSize = qint64(1) << 30;
+    if (argc > 1) {
+        maxSize = QByteArray(argv[1]).toLongLong() << 10;
+    }
+
+    for (qint64 size = 1 << 10; size <= maxSize; size <<= 5) {
+        // the text is size bytes long, its bytes take three quarters of it
+        QByteArray bytes(static_cast<int>(size / 4 * 3), Qt::Uninitialized);
+        auto words = reinterpret_cast<quint32 *>(bytes.data());
+        QRandomGenerator(size).fillRange(words, bytes.size() / 4);
+        auto text = bytes.toBase64();
+
+        measure("base64_decode", size, [&text] {
+            QByteArray out(Base64Decoder::bufferSize(text.size()), Qt::Uninitialized);
+            return Base64Decoder().decode(text.constData(), text.size(), out.data());
+        });
+        measure("qt_from_base64", size, [&text] {
+            return QByteArray::fromBase64(text).size();
+        });
+
+        QByteArray wrapped;
+        wrapped.reserve(text.size() / 76 * 77 + 77);
+        for (int pos = 0; pos < text.size(); pos += 76) {
+            wrapped.append(text.constData() + pos, qMin(76, text.size() - pos));
+            wrapped.append('\n');
+        }
+        measure("base64_decode_wrapped", size, [&wrapped] {
+            QByteArray out(Base64Decoder::bufferSize(wrapped.size()), Qt::Uninitialized);
+            return Base64Decoder().decode(wrapped.constData(), wrapped.size(), out.data());
+        });
+        measure("qt_from_base64_wrapped", size, [&wrapped] {
+            return QByteArray::fromBase64(wrapped).size();
+        });
+        wrapped = QByteArray();
+
+        measure("base64_encode", bytes.size(), [&bytes] {
+            QByteArray out(Base64Encoder::bufferSize(bytes.size()), Qt::Uninitialized);
+            return Base64Encoder::encode(bytes.constData(), bytes.size(), out.data());
+        });
+        measure("qt_to_base64", bytes.size(), [&bytes] {
+            return bytes.toBase64().size();
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,295 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Benchmarks of entity parsing and request building on synthetic payloads
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cstdio>
+#include <QtCore/QCborArray>
+#include <QtCore/QCborMap>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QJsonArray>
+#include <QtCore/QMap>
+#include <QtCore/QVector>
+
+#include "api/Wrapper.h"
+#include "api/utils/Base64Decoder.h"
+#include "WrapperTesting.h"
+
+/*!
+ * \class Benchmark
+ * \brief Benchmarks of the CPU hot paths, every result is printed as a JSON line
+ *
+ * Payloads look like the server responses: every file has its own content and belongs to one of
+ * a few hundred packages, which belong to a few dozen repositories.
+ */
+class Benchmark {
+public:
+    /*!
+     * \brief Run all the benchmarks on the given number of entities
+     * \param count Number of entities
+     */
+    static void run(int count);
+
+    /*!
+     * \brief Set a signed in user, so URLs are built like in a real session
+     */
+    static void signIn();
+
+private:
+    static constexpr int runs = 5;
+    static constexpr int contentSize = 1024;
+
+    /*!
+     * \brief Time an operation several times and print the best and the median time
+     * \param name Benchmark name
+     * \param count Number of entities the operation handles
+     * \param operation Operation to time
+     * \param cleanup Callback freeing what the operation has made, not timed
+     */
+    static void measure(const char *name, int count, const function<void()> &operation,
+                        const function<void()> &cleanup = nullptr);
+
+    static QByteArray content(int id);
+
+    static QJsonObject repositoryJson(int id);
+
+    static QJsonObject packageJson(int id);
+
+    static QJsonObject fileJson(int id);
+
+    static QCborMap repositoryCbor(int id);
+
+    static QCborMap packageCbor(int id);
+
+    static QCborMap fileCbor(int id);
+};
+
+void Benchmark::measure(const char *name, int count, const function<void()> &operation,
+                        const function<void()> &cleanup) {
+    QVector<qint64> times;
+    for (int i = 0; i < runs; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        operation();
+        times << timer.nsecsElapsed();
+        if (cleanup) {
+            cleanup();
+        }
+    }
+    std::sort(times.begin(), times.end());
+    printf(R"({"benchmark": "%s", "entities": %d, "runs": %d, "best_ns": %lld, "median_ns": %lld, "ns_per_entity": %.1f})"
+           "\n", name, count, runs, times.first(), times[runs / 2], double(times.first()) / count);
+    fflush(stdout);
+}
+
+QByteArray Benchmark::content(int id) {
+    QByteArray bytes(contentSize, Qt::Uninitialized);
+    for (int i = 0; i < contentSize; ++i) {
+        bytes[i] = static_cast<char>((id * 31 + i * 7) & 0xff);
+    }
+    return bytes;
+}
+
+QJsonObject Benchmark::repositoryJson(int id) {
+    auto number = QString::number(id);
+    return {{"id", id}, {"name", "repository-" + number}, {"url", "https://download.example.org/repositories/" + number},
+            {"manager", "zypper"}};
+}
+
+QJsonObject Benchmark::packageJson(int id) {
+    return {{"id", id}, {"name", "package-" + QString::number(id)}, {"repository", repositoryJson(3 + id % 40)}};
+}
+
+QJsonObject Benchmark::fileJson(int id) {
+    return {{"id", id}, {"name", QString("file-%1.conf").arg(id)}, {"path", QString("~/.config/app-%1").arg(id % 100)},
+            {"content", QString::fromLatin1(content(id).toBase64())},
+            {"checksum", QString::fromLatin1(QByteArray(64, 'a' + id % 6))},
+            {"created", "2019-10-16T12:34:56.789Z"}, {"modified", "2019-10-17T08:00:00+03:00"},
+            {"package", packageJson(2 + id % 400)}};
+}
+
+QCborMap Benchmark::repositoryCbor(int id) {
+    auto number = QString::number(id);
+    return {{"id", id}, {"name", "repository-" + number}, {"url", "https://download.example.org/repositories/" + number},
+            {"manager", "zypper"}};
+}
+
+QCborMap Benchmark::packageCbor(int id) {
+    return {{"id", id}, {"name", "package-" + QString::number(id)}, {"repository", repositoryCbor(3 + id % 40)}};
+}
+
+QCborMap Benchmark::fileCbor(int id) {
+    return {{"id", id}, {"name", QString("file-%1.conf").arg(id)}, {"path", QString("~/.config/app-%1").arg(id % 100)},
+            {"content", content(id)}, {"checksum", QString::fromLatin1(QByteArray(64, 'a' + id % 6))},
+            {"created", "2019-10-16T12:34:56.789Z"}, {"modified", "2019-10-17T08:00:00+03:00"},
+            {"package", packageCbor(2 + id % 400)}};
+}
+
+void Benchmark::signIn() {
+    Wrapper::Testing::signIn(User(QJsonObject{{"id", 42}, {"login", "penguin"}, {"name", "Penguin"},
+                                              {"token", QString(64, 'f')}}));
+}
+
+void Benchmark::run(int count) {
+    QList<QJsonObject> filesJson, packagesJson, repositoriesJson;
+    QCborArray filesCbor, packagesCbor, repositoriesCbor;
+    for (int id = 3; id < count + 3; ++id) {
+        filesJson << fileJson(id);
+        packagesJson << packageJson(id);
+        repositoriesJson << repositoryJson(id);
+        filesCbor << fileCbor(id);
+        packagesCbor << packageCbor(id);
+        repositoriesCbor << repositoryCbor(id);
+    }
+
+    QList<File *> files;
+    QList<Package *> packages;
+    QList<Repository *> repositories;
+    auto freeEntities = [&files, &packages, &repositories] {
+        qDeleteAll(files);
+        files.clear();
+        qDeleteAll(packages);
+        packages.clear();
+        qDeleteAll(repositories);
+        repositories.clear();
+    };
+
+    measure("file_json", count, [&filesJson, &files] {
+        for (auto &&json : filesJson) {
+            files << new File(json);
+        }
+    }, freeEntities);
+    measure("package_json", count, [&packagesJson, &packages] {
+        for (auto &&json : packagesJson) {
+            packages << new Package(json);
+        }
+    }, freeEntities);
+    measure("repository_json", count, [&repositoriesJson, &repositories] {
+        for (auto &&json : repositoriesJson) {
+            repositories << new Repository(json);
+        }
+    }, freeEntities);
+
+    // a CBOR listing is read straight from its bytes, the same way the list decoder passes its elements
+    auto readAll = [](const QCborArray &array, const function<void(QCborStreamReader &)> &read) {
+        auto cbor = array.toCborValue().toCbor();
+        return [cbor, read] {
+            QCborStreamReader reader(cbor);
+            CborReader::readArray(reader, [&reader, &read] {
+                read(reader);
+            });
+        };
+    };
+    measure("file_cbor", count, readAll(filesCbor, [&files](QCborStreamReader &reader) {
+        files << new File(reader);
+    }), freeEntities);
+    measure("package_cbor", count, readAll(packagesCbor, [&packages](QCborStreamReader &reader) {
+        packages << new Package(reader);
+    }), freeEntities);
+    measure("repository_cbor", count, readAll(repositoriesCbor, [&repositories](QCborStreamReader &reader) {
+        repositories << new Repository(reader);
+    }), freeEntities);
+
+    // every entity response is validated, and a listing is validated once with its whole list skipped
+    QList<QJsonObject> responsesJson;
+    for (auto &&json : filesJson) {
+        responsesJson << QJsonObject{{"ok", true}, {"file", json}};
+    }
+    measure("response_json", count, [&responsesJson] {
+        int ok = 0;
+        for (auto &&json : responsesJson) {
+            ok += Response(json).ok;
+        }
+        Q_UNUSED(ok)
+    });
+    auto listing = QCborMap{{"ok", true}, {"files", filesCbor}}.toCborValue().toCbor();
+    measure("response_cbor_listing", count, [&listing] {
+        ResponseBody(listing, true);
+    });
+
+    for (auto &&json : filesJson) {
+        files << new File(json);
+    }
+
+    measure("get_all_mapped", count, [&files] {
+        QMap<QString, File *> mapped;
+        for (auto &&file : files) {
+            mapped.insert(Wrapper::Testing::Files::key(file), file);
+        }
+    });
+
+    QList<QByteArray> contents;
+    for (auto &&json : filesJson) {
+        contents << json["content"].toString().toLatin1();
+    }
+    measure("base64_content", count, [&contents] {
+        QByteArray out(Base64Decoder::bufferSize(contentSize * 4 / 3 + 4), Qt::Uninitialized);
+        for (auto &&text : contents) {
+            Base64Decoder().decode(text.constData(), text.size(), out.data());
+        }
+    });
+
+    measure("url_building", count, [&files] {
+        int length = 0;
+        for (auto &&file : files) {
+            length += Wrapper::Testing::Files::entityUrl(file->id).path().size();
+            length += Wrapper::Testing::Files::contentUrl(file->id).path().size();
+        }
+        length += Wrapper::Testing::Files::sectionUrl().path().size();
+        Q_UNUSED(length)
+    });
+
+    measure("generate_multipart", count, [&files] {
+        for (auto &&file : files) {
+            delete Wrapper::Testing::generateMultipart(file);
+        }
+    });
+
+    freeEntities();
+}
+
+/*!
+ * \brief Run the benchmarks on 1k, 10k and 100k entities, or on the numbers given as arguments
+ */
+int main(int argc, char **argv) {
+    QList<int> counts{1000, 10000, 100000};
+    if (argc > 1) {
+        counts.clear();
+        for (int i = 1; i < argc; ++i) {
+            counts << QByteArray(argv[i]).toInt();
+        }
+    }
+
+    Benchmark::signIn();
+    for (auto &&count : counts) {
+        if (count > 0) {
+            Benchmark::run(count);
+        }
+    }
+    return 0;
+}
@@ -30,10 +30,15 @@
 #define ANTARCTICA_WRAPPER_H
 
 
+#include <functional>
+#include <memory>
 #include <QtCore/QString>
 #include <QtCore/QJsonArray>
 #include <QtNetwork/QHttpMultiPart>
 #include <QtCore/QJsonDocument>
+#include <QtCore/QFuture>
+#include <QtCore/QFutureInterface>
+#include <QtCore/QUrlQuery>
 #include <QtNetwork/QSslConfiguration>
 
 #include "api/models/User.h"
@@ -41,6 +46,15 @@
 #include "api/models/Package.h"
 #include "api/models/Repository.h"
 #include "api/models/Response.hpp"
+#include "api/utils/Metrics.h"
+#include "api/utils/ResponseBody.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QNetworkRequest;
+class QThread;
+class QIODevice;
+class StreamDecoder;
 
 using namespace std;
 
@@ -55,17 +69,45 @@ class Wrapper {
     inline static QString serverAddr = "https://antarctica-server.tk";
 
 public:
+    /*!
+     * \struct Wrapper::Options
+     * \brief Optional wrapper settings
+     */
+    struct Options {
+        QString cacheDirectory; ///< Directory to persist cached responses to, empty to keep them only in memory
+        bool http2 = false; ///< Offer HTTP/2 to multiplex requests over one connection, HTTP/1.1 is used if it is refused; it is offered only over TLS, cleartext (local) servers get HTTP/1.1 unless http2Cleartext is set
+        bool http2Cleartext = false; ///< Talk HTTP/2 to cleartext (local) servers right away (h2c with prior knowledge); there is no fallback, so the server must support it
+        int compressionLevel = 0; ///< Gzip level from 1 to 9 for uploaded file contents, used once the server says it takes gzip with "Accept-Encoding" in its responses, 0 to send them as is
+        bool cbor = false; ///< Ask for CBOR responses carrying file contents as raw bytes instead of base64, JSON is still understood
+        int retries = 3; ///< Attempts to repeat a request after a transient failure, 0 to fail at once
+        int retryDelay = 200; ///< Base delay before a repeated attempt in milliseconds, doubled with every attempt
+        int maxRetryDelay = 10000; ///< Maximal delay before a repeated attempt in milliseconds
+        int breakerThreshold = 5; ///< Transient failures in a row making requests fail at once, 0 to never do it
+        int breakerCooldown = 30000; ///< Time in milliseconds before a request is let through to a failed server
+        int fileCacheTtl = 0; ///< Time in milliseconds files got by id are cached for, 0 to always get them
+        int packageCacheTtl = 60000; ///< Time in milliseconds packages got by id are cached for, 0 to always get them
+        int repositoryCacheTtl = 300000; ///< Time in milliseconds repositories got by id are cached for, 0 to always get them
+        bool prewarm = false; ///< Connect to the server and complete the TLS handshake in background during init()
+        QString sessionFile; ///< File to keep the TLS session ticket in to resume the session on the next launch, empty to not keep it
+        QString userStore; ///< File to keep the authorized user in, restored by init() so authorize() may be skipped, empty to not keep it
+        function<bool(QString &, QString &)> credentials; ///< Callback filling the login and password to authorize again when the token is rejected, called in the network thread; the ones given to authorize() are used if it's not set
+    };
+
     /*!
      * \brief Set authentication data to static storage
      * \param id
      * \param token
      * \param sslConfig
+     * \param options Optional settings
      */
-    static void init(const QSslConfiguration &sslConfig, bool local) {
+    static void init(const QSslConfiguration &sslConfig, bool local, const Options &opts = Options()) {
         sslConfiguration = sslConfig;
         if (local) {
             serverAddr = "http://127.0.0.1:3000";
         }
+        options = opts;
+        restoreUser();
+        Utils::configure();
     }
 
     /*!
@@ -76,6 +118,69 @@ public:
      */
     static User authorize(const QString &login, const QString &password);
 
+    /*!
+     * \brief Get the authorized user
+     * A request rejected because of an expired token authorizes again and is sent once more with the new token,
+     * so the user may change at any time
+     * \return Authorized user, restored from Options::userStore by init() if it's set, or an empty one
+     */
+    static User currentUser();
+
+    /*!
+     * \struct Wrapper::ConnectionStats
+     * \brief Counters of the shared transport layer
+     */
+    struct ConnectionStats {
+        quint64 requests; ///< Requests sent to the server
+        quint64 handshakes; ///< TLS handshakes performed, i.e. new encrypted connections opened
+        quint64 multiplexed; ///< Responses received over HTTP/2
+        quint64 coalesced; ///< GET requests answered by an identical request already in flight, never sent; reads started after a write never join the ones started before it
+
+        /*!
+         * \brief Requests which went through an already established connection
+         */
+        quint64 reused() const {
+            return requests > handshakes ? requests - handshakes : 0;
+        }
+    };
+
+    /*!
+     * \brief Get connection reuse counters
+     * \return Number of sent requests and performed TLS handshakes
+     */
+    static ConnectionStats connectionStats();
+
+    /*!
+     * \struct Wrapper::CompressionStats
+     * \brief Counters of the uploaded file contents compression
+     */
+    struct CompressionStats {
+        quint64 contentBytes; ///< Size of the uploaded contents
+        quint64 sentBytes; ///< Size of the uploaded contents on the wire, after compression
+        quint64 compressionTime; ///< Time spent compressing in microseconds
+
+        /*!
+         * \brief Part of the content size which went on the wire
+         */
+        double ratio() const {
+            return contentBytes > 0 ? static_cast<double>(sentBytes) / contentBytes : 1;
+        }
+    };
+
+    /*!
+     * \brief Get upload compression counters
+     * \return Number of bytes before and after compression and the time spent on it
+     */
+    static CompressionStats compressionStats();
+
+    /*!
+     * \brief Get request metrics collected since the start
+     * Counters, errors and phase latencies by endpoint, serializable with Metrics::Snapshot::toJson()
+     * and Metrics::Snapshot::toPrometheus()
+     * \return Copy of the current metrics
+     */
+    static Metrics::Snapshot metrics();
+
     /*!
      * \class APIWrapper::Section
      * \brief An abstraction to implement wrapper for API section
@@ -131,6 +236,190 @@ public:
         * \return Request status ok or failed
         */
         static bool remove(int id);
+
+        /*!
+         * \struct APIWrapper::Section::CacheStats
+         * \brief Counters of the cache of entities got by id
+         */
+        struct CacheStats {
+            quint64 hits; ///< get() calls answered from the cache
+            quint64 misses; ///< get() calls which had to go to the server
+        };
+
+        /*!
+        * \brief Get counters of the cache used by get(), its entries live for the section's TTL from Options
+        * and are invalidated by update() and remove()
+        * \return Number of cache hits and misses
+        */
+        static CacheStats cacheStats();
+
+        /*!
+        * \brief Upload several entities keeping a number of requests in flight at once
+        * \param entities Entities to upload
+        * \param parallel Maximum number of requests sent at the same time
+        * \return Recently created entity ids in the order of entities, -1 for the failed ones
+        */
+        static QList<int> uploadMany(const QList<Entity *> &entities, int parallel = 6);
+
+        /*!
+        * \brief Update several entities keeping a number of requests in flight at once
+        * \param entities Entities to update
+        * \param parallel Maximum number of requests sent at the same time
+        * \return Request statuses in the order of entities
+        */
+        static QList<bool> updateMany(const QList<Entity *> &entities, int parallel = 6);
+
+        /*!
+        * \brief Delete several entities keeping a number of requests in flight at once
+        * \param ids IDs of entities to delete
+        * \param parallel Maximum number of requests sent at the same time
+        * \return Request statuses in the order of ids
+        */
+        static QList<bool> removeMany(const QList<int> &ids, int parallel = 6);
+
+        /*!
+        * \brief Non-blocking version of getAll()
+        * \return Future list of found entities
+        */
+        static QFuture<QList<Entity *>> getAllAsync();
+
+        /*!
+        * \brief Non-blocking version of getAll() yielding entities one by one
+        * Every entity is reported as a separate result as soon as it is received, before the whole list
+        * is downloaded, use QFutureIterator or QFutureWatcher::resultReadyAt() to consume them
+        * \return Future entities, the future is finished when the list is over
+        */
+        static QFuture<Entity *> getAllStreamed();
+
+        /*!
+        * \brief Non-blocking version of get()
+        * \param id ID of entity to search
+        * \return Future found entity or nullptr
+        */
+        static QFuture<Entity *> getAsync(int id);
+
+        /*!
+        * \brief Non-blocking version of upload()
+        * \param entity An entity to upload, must stay alive until the future is finished
+        * \return Future recently created entity id or -1
+        */
+        static QFuture<int> uploadAsync(const Entity *entity);
+
+        /*!
+        * \brief Non-blocking version of update()
+        * \param entity An entity to update, must stay alive until the future is finished
+        * \return Future request status: ok or failed
+        */
+        static QFuture<bool> updateAsync(const Entity *entity);
+
+        /*!
+        * \brief Non-blocking version of remove()
+        * \param id ID of entity to delete
+        * \return Future request status: ok or failed
+        */
+        static QFuture<bool> removeAsync(int id);
+
+        /*!
+         * \struct APIWrapper::Section::Changes
+         * \brief Entities changed at the server since a cursor
+         */
+        struct Changes {
+            QList<Entity *> created; ///< Recently created entities
+            QList<Entity *> updated; ///< Recently updated entities
+            QList<Entity *> deleted; ///< Recently deleted entities, a renamed entity is reported deleted and created
+            QString cursor; ///< Cursor to get the next changes since
+            bool ok = false; ///< Request status: ok or failed
+        };
+
+        /*!
+        * \brief Wrapper for changes API methods (GET request to "files/changes/{cursor}", "pkgs/..." or "repos/...")
+        * \tparam Entity Entity type: File, Package or Repository
+        * \param cursor Cursor returned by the previous call, empty to get all the entities as created
+        * \return Changes since the cursor
+        */
+        static Changes getChangesSince(const QString &cursor);
+
+        /*!
+        * \brief Non-blocking version of getChangesSince()
+        * \param cursor Cursor returned by the previous call, empty to get all the entities as created
+        * \return Future changes since the cursor
+        */
+        static QFuture<Changes> getChangesSinceAsync(const QString &cursor);
+
+        /*!
+        * \brief Apply changes to entities got from getAllMapped()
+        * The map takes ownership of created and updated entities, replaced and deleted ones are freed
+        * \param entities Mapped entities to update
+        * \param changes Changes got from getChangesSince()
+        */
+        static void merge(QMap<QString, Entity *> &entities, const Changes &changes);
+
+    protected:
+        /*!
+         * \brief Build URL of the section ("files", "pkgs" or "repos")
+         */
+        static QUrl sectionUrl();
+
+        /*!
+         * \brief Build URL of a single entity ("file/{id}", "pkg/{id}" or "repo/{id}")
+         * \param id Entity id
+         */
+        static QUrl entityUrl(int id);
+
+        /*!
+         * \brief Get the key used by getAllMapped(): the name, or the relative name for files
+         */
+        static QString key(const Entity *entity);
+
+        /*!
+         * \brief Get the time in milliseconds entities got by id are cached for
+         */
+        static int cacheTtl();
+
+        /*!
+         * \brief Drop a changed or deleted entity from the cache used by get()
+         * \param id Entity id
+         */
+        static void invalidate(int id);
+
+        /*!
+         * \brief Download the entity list passing every entity to the consumer as soon as it is received
+         * \param consumer Callback receiving every entity in the network thread
+         * \param handler Callback receiving the response without the list once it is finished
+         */
+        static void streamAll(const function<void(Entity *)> &consumer,
+                              const function<void(const ResponseBody &)> &handler);
+
+        /*!
+         * \brief Wrap every object of a JSON array into an entity
+         * \param array JSON array of entities
+         * \return List of entities
+         */
+        static QList<Entity *> parseArray(const QJsonArray &array);
+
+        /*!
+         * \brief Wrap every map of a CBOR array into an entity
+         * \param reader Reader at the array, left after it
+         * \return List of entities
+         */
+        static QList<Entity *> parseArray(QCborStreamReader &reader);
+
+        /*!
+         * \brief Wrap a single entity response
+         * \param body Response containing "file", "pkg" or "repo" object
+         * \param json Entity JSON to fill for a JSON response
+         * \param cbor Entity CBOR to fill for a CBOR response
+         * \return Entity or nullptr if the response contains an error
+         */
+        static Entity *parse(const ResponseBody &body, QJsonObject &json, QByteArray &cbor);
+
+        /*!
+         * \brief Wrap an entity kept by the entity cache
+         * \param json Entity JSON, used if there is no CBOR
+         * \param cbor Entity CBOR
+         * \return Entity
+         */
+        static Entity *construct(const QJsonObject &json, const QByteArray &cbor);
     };
 
     /*!
@@ -139,12 +428,144 @@ public:
     */
     class Files : public Section<File> {
     public:
+        /*!
+         * \struct APIWrapper::Files::ChunkedUpload
+         * \brief Settings and state of a resumable chunked upload
+         *
+         * The upload session is created with a POST request to "file/uploads", then every part is sent
+         * with its SHA-256 checksum via PUT request to "file/upload/{id}/chunk/{index}" and the session
+         * is finished with a POST request to "file/upload/{id}/complete". Parts acknowledged by the server
+         * are listed by a GET request to "file/upload/{id}", so a failed upload continues from them.
+         */
+        struct ChunkedUpload {
+            QString id; ///< Upload session id: empty to start a new upload, kept after a failure to resume it
+            qint64 chunkSize = 4 * 1024 * 1024; ///< Size of a part in bytes
+            int parallel = 4; ///< Number of parts uploaded at the same time
+            int attempts = 3; ///< Number of attempts to upload a part before giving up
+        };
+
+        /*!
+         * \brief Upload a file by parts, resuming the given upload session if it has an id
+         * \param file A file to upload
+         * \param upload Upload settings, its id is set to the session id
+         * \return Recently created file id or -1 if the upload has failed and may be resumed
+         */
+        static int uploadChunked(const File *file, ChunkedUpload &upload);
+
+        /*!
+         * \brief Update a file by parts, resuming the given upload session if it has an id
+         * \param file A file to update
+         * \param upload Upload settings, its id is set to the session id
+         * \return Request status: ok or failed, the failed upload may be resumed
+         */
+        static bool updateChunked(const File *file, ChunkedUpload &upload);
+
+        /*!
+         * \struct APIWrapper::Files::SyncReport
+         * \brief Summary of a sync() call
+         */
+        struct SyncReport {
+            int uploaded = 0; ///< New files sent to the server
+            int updated = 0; ///< Changed files sent to the server
+            int skipped = 0; ///< Files with the same checksum at the server
+            int reused = 0; ///< Sent files which reused the content already stored at the server
+            int failed = 0; ///< Files failed to send
+            qint64 bytesSent = 0; ///< Size of the content sent by the successful uploads
+        };
+
+        /*!
+         * \brief Send the local files which differ from the server ones
+         * Files are matched by their relative names and compared by checksums, unchanged files are skipped.
+         * Content already stored at the server (or sent earlier in this call) is not sent again:
+         * the file refers to the stored copy by a "source_id" form field instead.
+         * \param files Local files, their ids are set to the ids of the server files
+         * \param parallel Maximum number of files sent at once
+         * \return Numbers of sent, skipped and failed files
+         */
+        static SyncReport sync(const QList<File *> &files, int parallel = 6);
+
         /*!
          * \brief Wrapper for getting contents of a specific file
          * \param id File id
          * \return File contents
          */
         static QByteArray getContent(int id);
+
+        /*!
+         * \brief Wrapper for getting contents of a specific file written straight to a device
+         * The content is decoded while it is being downloaded, so memory usage doesn't depend on the file size
+         * \param id File id
+         * \param sink Opened device to write the contents to, must not be used by others until the call returns
+         * \return Number of written bytes or -1 if the request has failed
+         */
+        static qint64 getContent(int id, QIODevice *sink);
+
+        /*!
+         * \brief Non-blocking version of getContent()
+         * \param id File id
+         * \return Future file contents
+         */
+        static QFuture<QByteArray> getContentAsync(int id);
+
+        /*!
+         * \brief Non-blocking version of getContent(int, QIODevice *)
+         * \param id File id
+         * \param sink Opened device to write the contents to, must not be used by others until the future is finished
+         * \return Future number of written bytes or -1 if the request has failed
+         */
+        static QFuture<qint64> getContentAsync(int id, QIODevice *sink);
+
+        /*!
+         * \struct APIWrapper::Files::ContentsReport
+         * \brief Summary of a getContents() call
+         */
+        struct ContentsReport {
+            QList<qint64> written; ///< Number of bytes written for every id in the order of ids, -1 for the failed and skipped ones
+            int failed = 0; ///< Files failed to download or to write
+            int skipped = 0; ///< Files skipped because no device was created for them
+            qint64 bytes = 0; ///< Total size of the written contents
+            qint64 elapsed = 0; ///< Duration of the whole download in milliseconds
+
+            /*!
+             * \brief Get aggregate throughput of the download
+             * \return Written bytes per second
+             */
+            inline double throughput() const {
+                return elapsed > 0 ? bytes * 1000.0 / elapsed : 0;
+            }
+        };
+
+        /*!
+         * \brief Download contents of many files at the same time, each one written straight to its own device
+         * \param ids File ids
+         * \param sinkFactory Callback creating an opened device for a file id or returning nullptr to skip it,
+         * the device is closed and deleted once its file is downloaded
+         * \param parallel Maximum number of files downloaded at the same time
+         * \return Number of written bytes for every file and the aggregate throughput
+         */
+        static ContentsReport getContents(const QList<int> &ids, const function<QIODevice *(int)> &sinkFactory,
+                                          int parallel = 6);
+
+    protected:
+        /*!
+         * \brief Build URL of the file contents ("file/{id}/content")
+         * \param id File id
+         */
+        static QUrl contentUrl(int id);
+
+        /*!
+         * \brief Build URL of a chunked upload session ("file/upload/{id}" followed by the action)
+         * \param uploadId Upload session id
+         * \param action Action path, e.g. "chunk/{index}" or "complete", empty for the session itself
+         */
+        static QUrl uploadUrl(const QString &uploadId, const QString &action = QString());
+
+    private:
+        static QFuture<int> sendAsync(const File *file, bool update, int sourceId);
+
+        static int sendChunked(const File *file, ChunkedUpload &upload, int fileId);
+
+        static QFuture<bool> uploadChunkAsync(const QString &uploadId, int index, const QByteArray &chunk);
     };
 
     /*!
@@ -159,6 +580,13 @@ public:
          * \return List of files marked as given package's configs
          */
         static QList<File *> getConfigs(int id);
+
+        /*!
+         * \brief Non-blocking version of getConfigs()
+         * \param id Package id
+         * \return Future list of files marked as given package's configs
+         */
+        static QFuture<QList<File *>> getConfigsAsync(int id);
     };
 
 
@@ -169,9 +597,32 @@ public:
     class Repositories : public Section<Repository> {
     };
 
+    /*!
+    * \class APIWrapper::Testing
+    * \brief Access to the request builders for the tests and benchmarks, defined in src/WrapperTesting.h
+    */
+    class Testing;
+
 private:
     inline static User user; /**< User needed for API accessing */
     inline static QSslConfiguration sslConfiguration = QSslConfiguration::defaultConfiguration(); /**< An SSL configuration to perform an encrypted connection */
+    inline static Options options; /**< Optional settings given to init() */
+
+    /*!
+     * \brief Replace the authorized user, saving it to Options::userStore if it's set
+     */
+    static void setUser(const User &usr);
+
+    /*!
+     * \brief Load the user saved to Options::userStore
+     */
+    static void restoreUser();
+
+    /*!
+     * \brief Get the login and password to authorize again
+     * \return Whether there are any
+     */
+    static bool credentials(QString &login, QString &password);
 
     /*!
      * \class APIWrapper::Utils
@@ -189,24 +640,106 @@ private:
             GET, POST, PUT, DELETE
         };
 
+        /*!
+         * \brief Apply the options given to init()
+         */
+        static void configure();
+
+        /*!
+         * \brief Callback receiving the response of an asynchronous request, called in the network thread
+         */
+        using Handler = function<void(const ResponseBody &)>;
+
+        /*!
+         * \brief Callback generating a new multipart form for every attempt to send it,
+         * the request fails without being sent if it returns nullptr
+         */
+        using FormFactory = function<QHttpMultiPart *()>;
+
         /*!
          * \brief Execute an API request without form via GET or DELETE HTTP requests
          * \param requestUrl Prepared API request URL
          * \param type Type of HTTP request: GET or DELETE
-         * \return JSON response
+         * \return Response
          */
-        static QJsonDocument execute(const QUrl &requestUrl, RequestType type);
+        static ResponseBody execute(const QUrl &requestUrl, RequestType type);
 
         /*!
          * \brief Execute an API request with a form via POST or PUT HTTP requests
          * \param requestUrl Prepared API request URL
          * \param formData Multipart form data
          * \param type Type of HTTP request: POST or PUT
-         * \return JSON response
+         * \return Response
+         */
+        static ResponseBody executeForm(const QUrl &requestUrl, QHttpMultiPart *formData, RequestType type);
+
+        static ResponseBody executeForm(const QUrl &requestUrl, QUrlQuery &formData, RequestType type);
+
+        /*!
+         * \brief Start an API request without form via GET or DELETE HTTP requests
+         * \param requestUrl Prepared API request URL
+         * \param type Type of HTTP request: GET or DELETE
+         * \param handler Callback receiving the response
+         */
+        static void executeAsync(const QUrl &requestUrl, RequestType type, const Handler &handler);
+
+        /*!
+         * \brief Start an API request with a form via POST or PUT HTTP requests
+         * A ready form can't be sent again, so the request is not repeated after a transient failure
+         * \param requestUrl Prepared API request URL
+         * \param formData Multipart form data, owned by the request since now
+         * \param type Type of HTTP request: POST or PUT
+         * \param handler Callback receiving the response
+         */
+        static void executeFormAsync(const QUrl &requestUrl, QHttpMultiPart *formData, RequestType type,
+                                     const Handler &handler);
+
+        /*!
+         * \brief Start an API request with a form via POST or PUT HTTP requests, repeated after transient failures
+         * \param requestUrl Prepared API request URL
+         * \param generate Callback generating the form, called by the caller for the first attempt
+         * and in the network thread for the repeated ones
+         * \param type Type of HTTP request: POST or PUT
+         * \param handler Callback receiving the response
+         */
+        static void executeFormAsync(const QUrl &requestUrl, const FormFactory &generate, RequestType type,
+                                     const Handler &handler);
+
+        static void executeFormAsync(const QUrl &requestUrl, const QUrlQuery &formData, RequestType type,
+                                     const Handler &handler);
+
+        /*!
+         * \brief Start an API request via GET HTTP request passing the body to the decoder while it's downloaded
+         * \param requestUrl Prepared API request URL
+         * \param decoder Decoder consuming the response body in the network thread
+         * \param handler Callback receiving the response skeleton left by the decoder
+         * \param cacheable Whether the response is revalidated with the response cache like execute() does,
+         * its raw body is kept for the cache only up to a few megabytes and is never parsed whole
+         */
+        static void executeStreamed(const QUrl &requestUrl, const shared_ptr<StreamDecoder> &decoder,
+                                    const Handler &handler, bool cacheable = false);
+
+        /*!
+         * \brief Start uploading an entity with the form matching its type
+         * \param requestUrl Prepared API request URL
+         * \param entity File, Package or Repository to send
+         * \param type Type of HTTP request: POST or PUT
+         * \param handler Callback receiving the response
          */
-        static QJsonDocument executeForm(const QUrl &requestUrl, QHttpMultiPart *formData, RequestType type);
+        static void submitAsync(const QUrl &requestUrl, const File *entity, RequestType type, const Handler &handler);
+
+        static void submitAsync(const QUrl &requestUrl, const Package *entity, RequestType type,
+                                const Handler &handler);
+
+        static void submitAsync(const QUrl &requestUrl, const Repository *entity, RequestType type,
+                                const Handler &handler);
 
-        static QJsonDocument executeForm(const QUrl &requestUrl, QUrlQuery &formData, RequestType type);
+        /*!
+         * \brief Record time spent making entities from a response to the request metrics
+         * \param requestUrl URL of the GET request the entities came from
+         * \param nsecs Time in nanoseconds
+         */
+        static void recordConstruction(const QUrl &requestUrl, qint64 nsecs);
 
         static bool checkResponse(const Response &resp) {
             if (!resp.ok) {
@@ -216,7 +749,205 @@ private:
             return true;
         }
 
-        static QHttpMultiPart *generateMultipart(const File *file);
+        /*!
+         * \brief Generate the upload form of a file
+         * If the file content is empty, the file is streamed from the disk by its absolute name,
+         * so uploading takes a fixed amount of memory regardless of the file size
+         * \param file File to upload
+         * \param sourceId Id of a server file with the same content to copy it instead of sending, -1 to send it
+         * \return Multipart form data, to be owned by the reply it is sent with,
+         * or nullptr if the file has to be read from the disk and can't be opened
+         */
+        static QHttpMultiPart *generateMultipart(const File *file, int sourceId = -1);
+
+        /*!
+         * \brief Start uploading a file with its multipart form, repeated after transient failures
+         * The content is compressed once, while the first form is generated by the caller,
+         * and the forms of the repeated attempts reuse it; it is counted in compressionStats()
+         * once, when the upload succeeds
+         * \param requestUrl Prepared API request URL
+         * \param file File to upload
+         * \param sourceId Id of a server file with the same content to copy it instead of sending, -1 to send it
+         * \param type Type of HTTP request: POST or PUT
+         * \param handler Callback receiving the response
+         */
+        static void executeUploadAsync(const QUrl &requestUrl, const File *file, int sourceId, RequestType type,
+                                       const Handler &handler);
+
+        /*!
+         * \brief Generate the form of a single part of a chunked upload
+         * \param index Part index
+         * \param chunk Part data
+         * \return Multipart form data with the part and its checksum
+         */
+        static QHttpMultiPart *generateChunkMultipart(int index, const QByteArray &chunk);
+
+        static QUrlQuery generateForm(const Package *pkg, RequestType type);
+
+        static QUrlQuery generateForm(const Repository *repo, RequestType type);
+
+        /*!
+         * \brief Report the result of an asynchronous operation and finish it
+         * \param promise Interface of the future to resolve
+         * \param value Operation result
+         */
+        template<typename T>
+        static void resolve(QFutureInterface<T> promise, const T &value) {
+            promise.reportResult(value);
+            promise.reportFinished();
+        }
+
+        /*!
+         * \brief Block until the future is finished
+         * The calling thread sleeps until the network thread resolves the future, so it may be any thread,
+         * even one without an event loop, but never the network thread itself
+         * \param future Future to wait for
+         * \return Future result
+         */
+        template<typename T>
+        static T await(const QFuture<T> &future) {
+            return future.result();
+        }
+
+        template<class Result>
+        class Window;
+
+        /*!
+         * \brief Start a request for every item keeping at most the given number of them in flight
+         * \param items Items to send
+         * \param parallel Maximum number of requests in flight
+         * \param start Callback starting the request for an item
+         * \return Results in the order of items
+         */
+        template<class Item, class Result>
+        static QList<Result> sendAll(const QList<Item> &items, int parallel,
+                                     const function<QFuture<Result>(const Item &)> &start);
+
+        struct Compressed;
+
+    private:
+        static QHttpMultiPart *generateMultipart(const File *file, int sourceId, const shared_ptr<Compressed> &compressed);
+
+        /*!
+         * \brief Get the network thread, starting it on the first call
+         * The thread owns the access manager and all the replies, it is stopped when the application quits
+         * \return Network thread
+         */
+        static QThread *executor();
+
+        /*!
+         * \brief Run the task in the network thread
+         * \param task Task to run, it is called immediately if the caller is the network thread itself
+         */
+        static void dispatch(const function<void()> &task);
+
+        /*!
+         * \brief Get the access manager owned by the network thread, may be called only from that thread
+         * Its kept-alive connections are reused by all the requests
+         * \return Network access manager
+         */
+        static QNetworkAccessManager *manager();
+
+        /*!
+         * \brief Create a request with the wrapper's SSL configuration and transport options
+         * \param requestUrl URL to request
+         * \return Network request
+         */
+        static QNetworkRequest createRequest(const QUrl &requestUrl);
+
+        /*!
+         * \brief Get the endpoint name of a request used by the metrics
+         * \param requestUrl Request URL
+         * \param method HTTP method
+         * \return Method followed by the API path without ids and the access token, e.g. "GET file/{id}"
+         */
+        static QString endpoint(const QUrl &requestUrl, const QString &method);
+
+        /*!
+         * \brief Callback deciding whether a finished reply is sent again instead of being handled
+         */
+        using Retry = function<bool(const QNetworkReply *)>;
+
+        /*!
+         * \brief Callback sending a request in the network thread
+         * Returns the reply or nullptr if the request can't be sent (again)
+         */
+        using Sender = function<QNetworkReply *(const QNetworkRequest &)>;
+
+        /*!
+         * \brief Pass the reply's JSON to the handler once it is finished and free the reply
+         * Successful GET responses having validators are cached, a "304 Not Modified" reply is answered
+         * with the cached response
+         * \param reply Reply to wait for
+         * \param handler Callback receiving the response
+         * \param retry Callback which may send the request again, then the handler is left for the next reply
+         */
+        static void handleReply(QNetworkReply *reply, const Handler &handler, const Retry &retry = nullptr);
+
+        /*!
+         * \brief Send a request in the network thread, sending it again after transient failures
+         * Requests fail at once without being sent while the circuit breaker is open
+         * \param request Request to send, the same one for every attempt
+         * \param sender Callback sending the request
+         * \param handler Callback receiving the response of the last attempt
+         * \param attempt Number of attempts made before
+         * \param reauthorized Whether the request has already been sent again with a renewed token
+         * \param canResend Whether the sender can send the request again, otherwise the first reply is the final one
+         */
+        static void sendWithRetry(const QNetworkRequest &request, const Sender &sender, const Handler &handler,
+                                  int attempt = 0, bool reauthorized = false, bool canResend = true);
+
+        /*!
+         * \brief Send a multipart form in the network thread
+         * \param requestUrl Prepared API request URL
+         * \param generate Callback generating the form
+         * \param type Type of HTTP request: POST or PUT
+         * \param handler Callback receiving the response
+         * \param canResend Whether the form can be generated again to repeat the request
+         */
+        static void sendForm(const QUrl &requestUrl, const FormFactory &generate, RequestType type,
+                             const Handler &handler, bool canResend);
+
+        /*!
+         * \brief Prepare a request rejected because of an expired token to be sent again with a new one
+         * The user is authorized again unless the token has already been renewed by another request
+         * \param request Rejected request
+         * \param replay Callback receiving the request with the new token
+         * \param fail Callback called if the request can't be sent again
+         */
+        static void renewToken(const QNetworkRequest &request, const function<void(const QNetworkRequest &)> &replay,
+                               const function<void()> &fail);
+
+        /*!
+         * \brief Authorize again in the network thread, concurrent calls share one login request
+         * \param done Callback receiving whether the user has been authorized
+         */
+        static void reauthorize(const function<void(bool)> &done);
+
+        /*!
+         * \brief Streamed version of sendWithRetry(), the request is repeated only if the decoder got nothing
+         * \param request GET request to send
+         * \param decoder Decoder consuming the response body
+         * \param handler Callback receiving the response skeleton left by the decoder
+         * \param cacheable Whether the response is stored to the response cache
+         * \param attempt Number of attempts made before
+         * \param reauthorized Whether the request has already been sent again with a renewed token
+         */
+        static void streamWithRetry(const QNetworkRequest &request, const shared_ptr<StreamDecoder> &decoder,
+                                    const Handler &handler, bool cacheable, int attempt, bool reauthorized = false);
+
+        /*!
+         * \brief Count the reply in the circuit breaker and schedule another attempt if it has failed transiently:
+         * because of the connection or with 429, 502, 503 or 504 status
+         * The delay grows exponentially with jitter up to the maximum and respects the "Retry-After" header
+         * \param reply Finished reply
+         * \param attempt Number of attempts made before
+         * \param canResend Whether the request may be sent again at all
+         * \param resend Callback sending the request again
+         * \return Whether another attempt is scheduled
+         */
+        static bool retryIfTransient(const QNetworkReply *reply, int attempt, bool canResend,
+                                     const function<void()> &resend);
     };
 
 };
@@ -40,6 +40,7 @@
 
 #include "Package.h"
 #include "Entity.h"
+#include "api/utils/Base64Decoder.h"
 
 using namespace std;
 
@@ -81,7 +82,7 @@ public:
      * \param path Path where file is located
      * \param created File creation time and date
      * \param modified Last modified time and date
-     * \param content File content, by default empty
+     * \param content File content, by default empty: the file is read from the disk while uploading
      * \param pkg Package which file is according to, by default predefined package with id 1
      */
     File(QString name, QString path, QByteArray checksum, QDateTime created, QDateTime modified,
@@ -101,11 +102,49 @@ public:
         if (path.endsWith('/')) {
             path.remove(path.size() - 1, 1);
         }
-        content = QByteArray::fromBase64(fileJson["content"].toVariant().toByteArray());
-        checksum = fileJson["checksum"].toVariant().toByteArray();
-        created = fileJson["created"].toVariant().toDateTime();
-        modified = fileJson["modified"].toVariant().toDateTime();
-        package = new Package(fileJson["package"].toObject());
+        content = Base64Decoder().decode(fileJson["content"].toString().toLatin1());
+        checksum = fileJson["checksum"].toString().toUtf8();
+        created = parseTimestamp(fileJson["created"].toString());
+        modified = parseTimestamp(fileJson["modified"].toString());
+        package = IdentityMap<Package>::intern(fileJson["package"].toObject());
+    }
+
+    /*!
+     * \brief Constructor for wrapping server CBOR responses into a C++ class
+     * The content is a byte string with the file bytes as they are
+     * \param reader Reader at a file map of a CBOR response, left after it
+     */
+    explicit File(QCborStreamReader &reader) : package(nullptr) {
+        CborReader::readMap(reader, [this, &reader](const QString &key) {
+            if (key == "id") {
+                id = static_cast<int>(CborReader::readInteger(reader));
+            } else if (key == "name") {
+                name = CborReader::readString(reader);
+            } else if (key == "path") {
+                path = CborReader::readString(reader);
+            } else if (key == "content") {
+                // a server keeping the JSON layout sends base64 text instead
+                content = reader.isString()
+                          ? Base64Decoder().decode(CborReader::readString(reader).toLatin1())
+                          : CborReader::readBytes(reader);
+            } else if (key == "checksum") {
+                checksum = CborReader::readString(reader).toUtf8();
+            } else if (key == "created") {
+                created = parseTimestamp(CborReader::readString(reader));
+            } else if (key == "modified") {
+                modified = parseTimestamp(CborReader::readString(reader));
+            } else if (key == "package") {
+                package = IdentityMap<Package>::intern(reader);
+            } else {
+                reader.next();
+            }
+        });
+        if (path.endsWith('/')) {
+            path.remove(path.size() - 1, 1);
+        }
+        if (!package) { // the same as a JSON file without package
+            package = IdentityMap<Package>::intern(QJsonObject());
+        }
     }
 
     inline const QString getAbsolutePath() const {
@@ -121,6 +160,61 @@ public:
     }
 
     ~File() override = default;
+
+    /*!
+     * \brief Parse an ISO 8601 timestamp of the server responses
+     * Fixed "yyyy-MM-ddTHH:mm:ss[.zzz][Z|+HH:mm]" format is decoded in place,
+     * other formats fall back to QDateTime::fromString()
+     * \param text Timestamp text
+     * \return Date and time, invalid if the text is not a timestamp
+     */
+    static QDateTime parseTimestamp(const QString &text) {
+        const int size = text.size();
+        auto number = [&text](int pos, int count, int &value) {
+            value = 0;
+            for (int i = pos; i < pos + count; ++i) {
+                auto digit = text[i].unicode() - '0';
+                if (digit < 0 || digit > 9) {
+                    return false;
+                }
+                value = value * 10 + digit;
+            }
+            return true;
+        };
+
+        int year, month, day, hour, minute, second;
+        if (size < 19
+            || !number(0, 4, year) || text[4] != '-' || !number(5, 2, month) || text[7] != '-' || !number(8, 2, day)
+            || text[10] != 'T' || !number(11, 2, hour) || text[13] != ':' || !number(14, 2, minute)
+            || text[16] != ':' || !number(17, 2, second)) {
+            return QDateTime::fromString(text, Qt::ISODateWithMs);
+        }
+
+        int pos = 19;
+        int fraction = 0;
+        if (pos < size && text[pos] == '.') {
+            int scale = 1000;
+            for (++pos; pos < size && text[pos].isDigit(); ++pos) {
+                fraction += (text[pos].unicode() - '0') * scale;
+                scale /= 10;
+            }
+        }
+        QDate date(year, month, day);
+        QTime time(hour, minute, second, qMin((fraction + 5) / 10, 999));
+
+        if (pos == size) {
+            return QDateTime(date, time, Qt::LocalTime);
+        } else if (text[pos] == 'Z' && pos + 1 == size) {
+            return QDateTime(date, time, Qt::UTC);
+        }
+        int offsetHours, offsetMinutes;
+        if ((text[pos] == '+' || text[pos] == '-') && pos + 6 == size
+            && number(pos + 1, 2, offsetHours) && text[pos + 3] == ':' && number(pos + 4, 2, offsetMinutes)) {
+            auto offset = (offsetHours * 60 + offsetMinutes) * 60;
+            return QDateTime(date, time, Qt::OffsetFromUTC, text[pos] == '-' ? -offset : offset);
+        }
+        return QDateTime::fromString(text, Qt::ISODateWithMs);
+    }
 };
 
 
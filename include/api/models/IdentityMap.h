@@ -0,0 +1,116 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Identity map sharing the entities parsed from API responses
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_IDENTITYMAP_H
+#define ANTARCTICA_IDENTITYMAP_H
+
+
+#include <QtCore/QCborStreamReader>
+#include <QtCore/QHash>
+#include <QtCore/QJsonObject>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+
+/*!
+ * \class IdentityMap
+ * \brief Identity map sharing the entities parsed from API responses
+ *
+ * Only nested entities (the package of a file, the repository of a package) are interned by their ids,
+ * so the files of an unchanged package point to the same Package object and pointer comparison means
+ * entity equality. Predefined entities are mapped to their singletons. The entities returned by
+ * the Packages and Repositories sections themselves are separate objects owned by the caller.
+ * Interned entities are never modified, so they are safe to read from any thread: a later response
+ * with changed fields interns a new entity under the same id, which is given to the entities parsed from then on.
+ * The replaced one stays valid for the entities parsed before, all of them live until clear() is called.
+ * \tparam Entity Entity type: Package or Repository
+ */
+template<class Entity>
+class IdentityMap {
+    inline static QHash<int, Entity *> entities;
+    inline static QList<Entity *> replaced;
+    inline static QMutex mutex;
+
+public:
+    /*!
+     * \brief Get the entity described by a JSON object, creating it on the first call and refreshing it later
+     * \param json A JSON object from server containing the entity
+     * \return Shared entity
+     */
+    static Entity *intern(const QJsonObject &json) {
+        auto id = json["id"].toInt();
+        if (auto predefined = Entity::predefined(id)) {
+            return predefined;
+        }
+        return intern(Entity(json));
+    }
+
+    /*!
+     * \brief Get the entity described by a CBOR map, creating it on the first call and refreshing it later
+     * \param reader Reader at a map of a CBOR response containing the entity, left after it
+     * \return Shared entity
+     */
+    static Entity *intern(QCborStreamReader &reader) {
+        Entity parsed(reader);
+        if (auto predefined = Entity::predefined(parsed.id)) {
+            return predefined;
+        }
+        return intern(parsed);
+    }
+
+private:
+    static Entity *intern(const Entity &parsed) {
+        QMutexLocker locker(&mutex);
+        auto &entity = entities[parsed.id];
+        if (entity && entity->equals(parsed)) {
+            return entity;
+        }
+        if (entity) { // still pointed to by the entities parsed before
+            replaced << entity;
+        }
+        entity = new Entity(parsed);
+        return entity;
+    }
+
+public:
+
+    /*!
+     * \brief Free all the interned entities and start a new session
+     * Entities parsed before must not be used after that
+     */
+    static void clear() {
+        QMutexLocker locker(&mutex);
+        qDeleteAll(entities);
+        entities.clear();
+        qDeleteAll(replaced);
+        replaced.clear();
+    }
+};
+
+
+#endif //ANTARCTICA_IDENTITYMAP_H
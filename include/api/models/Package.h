@@ -34,6 +34,7 @@
 #include "Repository.h"
 
 #include "Entity.h"
+#include "IdentityMap.h"
 
 using namespace std;
 
@@ -72,11 +73,49 @@ public:
     explicit Package(QJsonObject pkgJson) {
         id = pkgJson["id"].toInt();
         name = pkgJson["name"].toString();
-        repository = new Repository(pkgJson["repository"].toObject());
+        repository = IdentityMap<Repository>::intern(pkgJson["repository"].toObject());
+    }
+
+    /*!
+     * \brief Constructor for wrapping server CBOR responses into a C++ class
+     * \param reader Reader at a package map of a CBOR response, left after it
+     */
+    explicit Package(QCborStreamReader &reader) {
+        CborReader::readMap(reader, [this, &reader](const QString &key) {
+            if (key == "id") {
+                id = static_cast<int>(CborReader::readInteger(reader));
+            } else if (key == "name") {
+                name = CborReader::readString(reader);
+            } else if (key == "repository") {
+                repository = IdentityMap<Repository>::intern(reader);
+            } else {
+                reader.next();
+            }
+        });
+        if (!repository) { // the same as a JSON package without repository
+            repository = IdentityMap<Repository>::intern(QJsonObject());
+        }
     }
 
     ~Package() override = default;
 
+    /*!
+     * \brief Check whether another copy of the same package has the same fields
+     * \param other Package parsed from another response
+     */
+    bool equals(const Package &other) const {
+        return name == other.name && repository == other.repository;
+    }
+
+    /*!
+     * \brief Get a predefined package by its id
+     * \param id Package id
+     * \return Predefined package or nullptr
+     */
+    static Package *predefined(int id) {
+        return id == Default->id ? Default : nullptr;
+    }
+
     /*!
      * \brief Predefined default package (id 1) entity for user files
      */
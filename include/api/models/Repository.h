@@ -34,6 +34,7 @@
 #include <QtCore/QJsonObject>
 
 #include "Entity.h"
+#include "api/utils/CborReader.h"
 
 using namespace std;
 
@@ -81,8 +82,50 @@ public:
         manager = repoJson["manager"].toString();
     }
 
+    /*!
+     * \brief Constructor for wrapping server CBOR responses into a C++ class
+     * \param reader Reader at a repository map of a CBOR response, left after it
+     */
+    explicit Repository(QCborStreamReader &reader) {
+        CborReader::readMap(reader, [this, &reader](const QString &key) {
+            if (key == "id") {
+                id = static_cast<int>(CborReader::readInteger(reader));
+            } else if (key == "name") {
+                name = CborReader::readString(reader);
+            } else if (key == "url") {
+                url = CborReader::readString(reader);
+            } else if (key == "manager") {
+                manager = CborReader::readString(reader);
+            } else {
+                reader.next();
+            }
+        });
+    }
+
     ~Repository() override = default;
 
+    /*!
+     * \brief Check whether another copy of the same repository has the same fields
+     * \param other Repository parsed from another response
+     */
+    bool equals(const Repository &other) const {
+        return name == other.name && url == other.url && manager == other.manager;
+    }
+
+    /*!
+     * \brief Get a predefined repository by its id
+     * \param id Repository id
+     * \return Predefined repository or nullptr
+     */
+    static Repository *predefined(int id) {
+        if (id == NoRepo->id) {
+            return NoRepo;
+        } else if (id == Default->id) {
+            return Default;
+        }
+        return nullptr;
+    }
+
     /*!
      * \brief Predefined no repository (id 1) entity for user files
      */
@@ -29,9 +29,12 @@
 #ifndef ANTARCTICA_RESPONSE_HPP
 #define ANTARCTICA_RESPONSE_HPP
 
+#include <functional>
 #include <QtCore/QString>
 #include <QtCore/QJsonObject>
 
+#include "api/utils/CborReader.h"
+
 /*!
  * \class Response
  * \brief The response entity for wrapping and checking API responses
@@ -74,6 +77,22 @@ public:
             code = static_cast<Code>(errJson["code"].toInt());
             text = errJson["text"].toString();
         }
+
+        /*!
+        * \brief Constructor for wrapping server CBOR responses into a C++ class
+        * \param reader Reader at an error map of a CBOR response, left after it
+        */
+        explicit Error(QCborStreamReader &reader) : code(Code::OK), text() {
+            CborReader::readMap(reader, [this, &reader](const QString &key) {
+                if (key == "code") {
+                    code = static_cast<Code>(CborReader::readInteger(reader));
+                } else if (key == "text") {
+                    text = CborReader::readString(reader);
+                } else {
+                    reader.next();
+                }
+            });
+        }
     } error;
 
     /*!
@@ -106,6 +125,8 @@ public:
                   || (respJson.contains("repos") && respJson["repos"].isArray())
                   || (respJson.contains("repo") && respJson["repo"].isObject())
                   || (respJson.contains("user") && respJson["user"].isObject())
+                  || (respJson.contains("upload") && respJson["upload"].isObject())
+                  || (respJson.contains("changes") && respJson["changes"].isObject())
                   || (respJson.contains("created_id")))) {
             ok = false;
             error.code = Error::Code::MissingFields;
@@ -114,6 +135,48 @@ public:
             error.code = Error::Code::OK;
         }
     }
+
+    /*!
+     * \brief Constructor for wrapping server CBOR responses into a C++ class
+     * The response is read in one pass, so the values besides the status go to the callback as they come
+     * \param reader Reader at the root map of a CBOR response
+     * \param readValue Callback called with the reader at the value of every other key, it must consume the value;
+     * the values are skipped if there is no callback
+     */
+    explicit Response(QCborStreamReader &reader,
+                      const std::function<void(const QString &, QCborStreamReader &)> &readValue = nullptr) : ok(false) {
+        bool hasError = false;
+        bool hasData = false;
+        auto wellFormed = CborReader::readMap(reader, [&](const QString &key) {
+            if (key == "ok") {
+                ok = CborReader::readBool(reader);
+                return;
+            } else if (key == "error" && reader.isMap()) {
+                error = Error(reader);
+                hasError = true;
+                return;
+            }
+            hasData = hasData || key == "created_id"
+                      || (reader.isArray() && (key == "files" || key == "pkgs" || key == "repos"))
+                      || (reader.isMap() && (key == "file" || key == "pkg" || key == "repo" || key == "user"
+                                             || key == "upload" || key == "changes"));
+            if (readValue) {
+                readValue(key, reader);
+            } else {
+                reader.next();
+            }
+        });
+        if (!wellFormed) {
+            ok = false;
+        }
+        if (!hasError && !hasData) {
+            ok = false;
+            error.code = Error::Code::MissingFields;
+        }
+        if (ok) {
+            error.code = Error::Code::OK;
+        }
+    }
 };
 
 #endif //ANTARCTICA_RESPONSE_HPP
@@ -0,0 +1,80 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Base64 decoding of file contents
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_BASE64DECODER_H
+#define ANTARCTICA_BASE64DECODER_H
+
+
+#include <QtCore/QByteArray>
+
+/*!
+ * \class Base64Decoder
+ * \brief Base64 decoder which can be fed by chunks of any size
+ *
+ * Works exactly like QByteArray::fromBase64() with default options: characters outside
+ * the alphabet (including padding and line breaks) are skipped.
+ * Runs of clean base64 are decoded by AVX2 or SSSE3 instructions if the processor has them.
+ */
+class Base64Decoder {
+public:
+    /*!
+     * \brief Get the size of the buffer decode() may write to
+     * \param size Number of characters
+     */
+    static inline int bufferSize(int size) {
+        return size / 4 * 3 + 16; // bytes left from the previous part and room for the vector stores
+    }
+
+    /*!
+     * \brief Decode the next part of the input into a preallocated buffer
+     * \param data Base64 characters
+     * \param size Number of characters
+     * \param out Buffer of bufferSize(size) bytes
+     * \return Number of bytes completed by this part
+     */
+    int decode(const char *data, int size, char *out);
+
+    /*!
+     * \brief Decode the next part of the input
+     * \param data Base64 characters
+     * \param size Number of characters
+     * \return Bytes completed by this part
+     */
+    QByteArray decode(const char *data, int size);
+
+    inline QByteArray decode(const QByteArray &data) {
+        return decode(data.constData(), data.size());
+    }
+
+private:
+    uint buffer = 0;
+    int bits = 0;
+};
+
+
+#endif //ANTARCTICA_BASE64DECODER_H
@@ -0,0 +1,69 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Vectorized base64 encoder
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_BASE64ENCODER_H
+#define ANTARCTICA_BASE64ENCODER_H
+
+
+#include <QtCore/QByteArray>
+
+/*!
+ * \class Base64Encoder
+ * \brief Base64 encoder producing the same text as QByteArray::toBase64() with default options
+ *
+ * Whole blocks are encoded by AVX2 or SSSE3 instructions if the processor has them.
+ */
+class Base64Encoder {
+public:
+    /*!
+     * \brief Get the size of the buffer encode() writes to
+     * \param size Number of bytes
+     */
+    static inline int bufferSize(int size) {
+        return (size + 2) / 3 * 4;
+    }
+
+    /*!
+     * \brief Encode bytes into a preallocated buffer, padding the last quad
+     * \param data Bytes
+     * \param size Number of bytes
+     * \param out Buffer of bufferSize(size) characters
+     * \return Number of characters written
+     */
+    static int encode(const char *data, int size, char *out);
+
+    /*!
+     * \brief Encode bytes
+     * \param data Bytes
+     * \return Base64 text
+     */
+    static QByteArray encode(const QByteArray &data);
+};
+
+
+#endif //ANTARCTICA_BASE64ENCODER_H
@@ -0,0 +1,167 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Helpers reading CBOR responses straight into models
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_CBORREADER_H
+#define ANTARCTICA_CBORREADER_H
+
+
+#include <functional>
+#include <QtCore/QByteArray>
+#include <QtCore/QCborStreamReader>
+#include <QtCore/QString>
+
+/*!
+ * \class CborReader
+ * \brief Helpers reading the values of CBOR responses with QCborStreamReader
+ *
+ * Every helper consumes exactly one item and leaves the reader at the next one. An item of another type
+ * is skipped and an empty value is returned, so models are as tolerant to CBOR responses as to JSON ones.
+ */
+class CborReader {
+public:
+    /*!
+     * \brief Read a text string
+     * \param reader Reader at the string
+     * \return String, empty if the item is not a string
+     */
+    static QString readString(QCborStreamReader &reader) {
+        skipTags(reader);
+        if (!reader.isString()) {
+            reader.next();
+            return QString();
+        }
+        QString text;
+        auto chunk = reader.readString();
+        while (chunk.status == QCborStreamReader::Ok) {
+            text += chunk.data;
+            chunk = reader.readString();
+        }
+        return chunk.status == QCborStreamReader::Error ? QString() : text;
+    }
+
+    /*!
+     * \brief Read a byte string
+     * \param reader Reader at the byte string
+     * \return Bytes, empty if the item is not a byte string
+     */
+    static QByteArray readBytes(QCborStreamReader &reader) {
+        skipTags(reader);
+        if (!reader.isByteArray()) {
+            reader.next();
+            return QByteArray();
+        }
+        QByteArray bytes;
+        auto chunk = reader.readByteArray();
+        while (chunk.status == QCborStreamReader::Ok) {
+            bytes += chunk.data;
+            chunk = reader.readByteArray();
+        }
+        return chunk.status == QCborStreamReader::Error ? QByteArray() : bytes;
+    }
+
+    /*!
+     * \brief Read an integer
+     * \param reader Reader at the integer
+     * \return Integer, 0 if the item is not a number
+     */
+    static qint64 readInteger(QCborStreamReader &reader) {
+        skipTags(reader);
+        qint64 value = 0;
+        if (reader.isInteger()) {
+            value = reader.toInteger();
+        } else if (reader.isDouble()) {
+            value = static_cast<qint64>(reader.toDouble());
+        }
+        reader.next();
+        return value;
+    }
+
+    /*!
+     * \brief Read a boolean
+     * \param reader Reader at the boolean
+     * \return Boolean, false if the item is not a boolean
+     */
+    static bool readBool(QCborStreamReader &reader) {
+        skipTags(reader);
+        bool value = reader.isBool() && reader.toBool();
+        reader.next();
+        return value;
+    }
+
+    /*!
+     * \brief Read a map with text keys
+     * \param reader Reader at the map
+     * \param readValue Callback called with the reader at the value of every key, it must consume the value
+     * \return Whether the item is a well-formed map
+     */
+    static bool readMap(QCborStreamReader &reader, const std::function<void(const QString &)> &readValue) {
+        skipTags(reader);
+        if (!reader.isMap()) {
+            reader.next();
+            return false;
+        }
+        if (!reader.enterContainer()) {
+            return false;
+        }
+        while (reader.lastError() == QCborError::NoError && reader.hasNext()) {
+            auto key = readString(reader); // other keys are read as empty ones, which nobody looks for
+            readValue(key);
+        }
+        return reader.lastError() == QCborError::NoError && reader.leaveContainer();
+    }
+
+    /*!
+     * \brief Read an array
+     * \param reader Reader at the array
+     * \param readItem Callback called with the reader at every item, it must consume the item
+     * \return Whether the item is a well-formed array
+     */
+    static bool readArray(QCborStreamReader &reader, const std::function<void()> &readItem) {
+        skipTags(reader);
+        if (!reader.isArray()) {
+            reader.next();
+            return false;
+        }
+        if (!reader.enterContainer()) {
+            return false;
+        }
+        while (reader.lastError() == QCborError::NoError && reader.hasNext()) {
+            readItem();
+        }
+        return reader.lastError() == QCborError::NoError && reader.leaveContainer();
+    }
+
+private:
+    static void skipTags(QCborStreamReader &reader) {
+        while (reader.isTag() && reader.next()) {
+        }
+    }
+};
+
+
+#endif //ANTARCTICA_CBORREADER_H
@@ -0,0 +1,115 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief In-memory cache of single entities with expiration
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_ENTITYCACHE_H
+#define ANTARCTICA_ENTITYCACHE_H
+
+
+#include <QtCore/QByteArray>
+#include <QtCore/QCache>
+#include <QtCore/QDeadlineTimer>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMutex>
+
+/*!
+ * \class EntityCache
+ * \brief Cache of entities got by id, the least recently used ones are dropped when it is full
+ *
+ * Entities are kept as received, JSON or CBOR, so every lookup makes a new entity owned by the caller.
+ * Every entry expires after the time to live given when it was stored. Writes invalidate
+ * the written id, and a response requested before the invalidation is not stored after it,
+ * so the cache never goes back to the state before a write.
+ */
+class EntityCache {
+public:
+    /*!
+     * \struct EntityCache::Stats
+     * \brief Lookup counters
+     */
+    struct Stats {
+        quint64 hits; ///< Lookups answered from the cache
+        quint64 misses; ///< Lookups which had to go to the server
+    };
+
+    /*!
+     * \brief Constructor
+     * \param capacity Maximal number of entries
+     */
+    explicit EntityCache(int capacity = 1024) : entries(capacity) {}
+
+    /*!
+     * \brief Find a live entry
+     * \param id Entity id
+     * \param json Entity JSON to fill
+     * \param cbor Entity CBOR to fill, empty if the entity has been received as JSON
+     * \return Whether the entity is cached and hasn't expired
+     */
+    bool lookup(int id, QJsonObject &json, QByteArray &cbor);
+
+    /*!
+     * \brief Get the token to pass to store() for a response requested now
+     */
+    quint64 version();
+
+    /*!
+     * \brief Cache an entity unless it has been invalidated since its request was started
+     * \param id Entity id
+     * \param json Entity JSON, empty if the entity has been received as CBOR
+     * \param cbor Entity CBOR, empty if the entity has been received as JSON
+     * \param ttl Time to live in milliseconds, the entity isn't stored if it's not positive
+     * \param requested Token got from version() when the request was started
+     */
+    void store(int id, const QJsonObject &json, const QByteArray &cbor, int ttl, quint64 requested);
+
+    /*!
+     * \brief Drop an entity after it has been changed or deleted
+     * \param id Entity id
+     */
+    void invalidate(int id);
+
+    /*!
+     * \brief Get lookup counters
+     */
+    Stats stats();
+
+private:
+    struct Entry {
+        QJsonObject json;
+        QByteArray cbor;
+        QDeadlineTimer expires;
+    };
+
+    QMutex mutex;
+    QCache<int, Entry> entries;
+    quint64 invalidations = 0;
+    quint64 hits = 0;
+    quint64 misses = 0;
+};
+
+
+#endif //ANTARCTICA_ENTITYCACHE_H
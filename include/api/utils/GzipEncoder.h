@@ -0,0 +1,88 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Gzip compression of uploaded file contents
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_GZIPENCODER_H
+#define ANTARCTICA_GZIPENCODER_H
+
+
+#include <memory>
+#include <QtCore/QByteArray>
+
+struct z_stream_s;
+
+/*!
+ * \class GzipEncoder
+ * \brief Gzip encoder which can be fed by chunks of any size
+ *
+ * Produces a single gzip member, so the result is understood by any server
+ * accepting "Content-Encoding: gzip".
+ */
+class GzipEncoder {
+public:
+    /*!
+     * \brief Constructor
+     * \param level Compression level from 1 (fastest) to 9 (smallest)
+     */
+    explicit GzipEncoder(int level);
+
+    ~GzipEncoder();
+
+    /*!
+     * \brief Compress the next part of the input
+     * \param data Bytes to compress
+     * \param size Number of bytes
+     * \return Compressed bytes ready so far, may be empty
+     */
+    QByteArray encode(const char *data, int size);
+
+    inline QByteArray encode(const QByteArray &data) {
+        return encode(data.constData(), data.size());
+    }
+
+    /*!
+     * \brief Flush the rest of the compressed data and the gzip trailer
+     * \return Last compressed bytes
+     */
+    QByteArray finish();
+
+    /*!
+     * \brief Check whether the encoder has failed, e.g. because of a wrong level
+     */
+    inline bool failed() const {
+        return error;
+    }
+
+private:
+    QByteArray run(const char *data, int size, int flush);
+
+    std::unique_ptr<z_stream_s> stream;
+    bool error = false;
+};
+
+
+#endif //ANTARCTICA_GZIPENCODER_H
@@ -0,0 +1,142 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Request metrics collected by the wrapper
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_METRICS_H
+#define ANTARCTICA_METRICS_H
+
+
+#include <QtCore/QByteArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+/*!
+ * \class Metrics
+ * \brief Request counters and latency histograms by endpoint
+ *
+ * An endpoint is the HTTP method with the API path, ids and the access token left out,
+ * e.g. "GET files" or "PUT file/{id}". Every request is split into phases timed separately.
+ */
+class Metrics {
+public:
+    /*!
+     * \enum Phase
+     * \brief Timed parts of a request
+     */
+    enum Phase {
+        Queue, ///< Waiting for the network thread
+        Connect, ///< Opening a new connection with its TLS handshake, reused connections skip it
+        FirstByte, ///< From sending the request to receiving the response headers
+        Transfer, ///< From the response headers to the end of the body
+        Parse, ///< Parsing or decoding the JSON response
+        Construction, ///< Making entities from the response
+        PhaseCount
+    };
+
+    /*!
+     * \struct Metrics::Histogram
+     * \brief Latency distribution in milliseconds
+     */
+    struct Histogram {
+        QVector<quint64> buckets = QVector<quint64>(bounds().size() + 1); ///< Observations by bucket, the last one is unbounded
+        quint64 count = 0; ///< Number of observations
+        double sum = 0; ///< Sum of observations in milliseconds
+
+        /*!
+         * \brief Upper bounds of the buckets in milliseconds
+         */
+        static const QVector<double> &bounds();
+
+        void add(double msecs);
+    };
+
+    /*!
+     * \struct Metrics::Endpoint
+     * \brief Metrics of a single endpoint
+     */
+    struct Endpoint {
+        quint64 requests = 0; ///< Finished requests
+        quint64 bytesIn = 0; ///< Response bytes received
+        quint64 bytesOut = 0; ///< Request bytes sent
+        QMap<int, quint64> errors; ///< Failed responses by Response::Error::Code
+        Histogram phases[PhaseCount]; ///< Latency of every phase
+    };
+
+    /*!
+     * \struct Metrics::Snapshot
+     * \brief Copy of all the metrics at some moment
+     */
+    struct Snapshot {
+        QMap<QString, Endpoint> endpoints; ///< Metrics by endpoint
+
+        /*!
+         * \brief Serialize the snapshot to JSON
+         */
+        QJsonObject toJson() const;
+
+        /*!
+         * \brief Serialize the snapshot to Prometheus text exposition format, latencies are in seconds
+         */
+        QByteArray toPrometheus() const;
+    };
+
+    /*!
+     * \brief Build the endpoint name of a request
+     * \param method HTTP method
+     * \param path URL path
+     * \param token Access token to leave out of the path
+     */
+    static QString endpoint(const QString &method, const QString &path, const QString &token);
+
+    /*!
+     * \brief Get the name of a phase as used in the serialized metrics
+     */
+    static QString phaseName(Phase phase);
+
+    /*!
+     * \brief Get the name of a Response::Error::Code as used in the serialized metrics
+     */
+    static QString errorName(int code);
+
+    void record(const QString &endpoint, Phase phase, qint64 nsecs);
+
+    void finished(const QString &endpoint, qint64 bytesIn, qint64 bytesOut);
+
+    void failed(const QString &endpoint, int code);
+
+    Snapshot snapshot();
+
+private:
+    QMutex mutex;
+    Snapshot data;
+};
+
+
+#endif //ANTARCTICA_METRICS_H
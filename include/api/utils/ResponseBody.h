@@ -0,0 +1,134 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Body of an API response in either of the formats the server answers with
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_RESPONSEBODY_H
+#define ANTARCTICA_RESPONSEBODY_H
+
+
+#include <functional>
+#include <QtCore/QByteArray>
+#include <QtCore/QCborStreamReader>
+#include <QtCore/QCborValue>
+#include <QtCore/QJsonDocument>
+
+#include "api/models/Response.hpp"
+
+/*!
+ * \brief Convert a CBOR value to JSON the way the API serializes it
+ * Unlike QCborValue::toJsonValue() byte strings become standard base64 text.
+ * \param value CBOR value
+ * \return JSON value
+ */
+QJsonValue cborToJson(const QCborValue &value);
+
+/*!
+ * \class ResponseBody
+ * \brief Body of an API response, JSON or CBOR as the server has sent it
+ *
+ * A JSON body is parsed whole, a CBOR body is kept as it is and is read by the models straight from its bytes,
+ * so nothing is converted between the formats. Only the status is read up front.
+ */
+class ResponseBody {
+public:
+    using Reader = std::function<void(const QString &, QCborStreamReader &)>;
+
+    /*!
+     * \brief Constructor for a request which has got no response
+     */
+    ResponseBody() : response(QJsonObject()) {}
+
+    /*!
+     * \brief Constructor for a parsed JSON body
+     * \param json JSON document
+     */
+    explicit ResponseBody(const QJsonDocument &json) : document(json), response(json.object()) {}
+
+    /*!
+     * \brief Constructor for a body received from the server
+     * \param body Body bytes
+     * \param cbor Whether the body is CBOR, otherwise it is JSON
+     */
+    ResponseBody(const QByteArray &body, bool cbor);
+
+    /*!
+     * \brief Check whether the body is CBOR
+     */
+    inline bool isCbor() const {
+        return cbor;
+    }
+
+    /*!
+     * \brief Get the JSON document, null for a CBOR body
+     */
+    inline const QJsonDocument &json() const {
+        return document;
+    }
+
+    /*!
+     * \brief Get the CBOR bytes, empty for a JSON body
+     */
+    inline const QByteArray &data() const {
+        return bytes;
+    }
+
+    /*!
+     * \brief Get the status of the response
+     */
+    inline const Response &status() const {
+        return response;
+    }
+
+    /*!
+     * \brief Read the CBOR body in one pass
+     * \param readValue Callback called with the reader at the value of every root key besides the status ones,
+     * it must consume the value
+     * \return Status of the response, the same as status()
+     */
+    Response read(const Reader &readValue) const;
+
+    /*!
+     * \brief Get a root value as JSON, meant for the small values like ids
+     * \param key Root key
+     * \return JSON value, undefined if there is no such key
+     */
+    QJsonValue value(const QString &key) const;
+
+    /*!
+     * \brief Get the body text for logging
+     */
+    QString toString() const;
+
+private:
+    QJsonDocument document;
+    QByteArray bytes;
+    bool cbor = false;
+    Response response;
+};
+
+
+#endif //ANTARCTICA_RESPONSEBODY_H
@@ -0,0 +1,131 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Cache of API responses revalidated with conditional requests
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_RESPONSECACHE_H
+#define ANTARCTICA_RESPONSECACHE_H
+
+
+#include <QtCore/QHash>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QMutex>
+#include <QtCore/QStringList>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QUrl>
+
+/*!
+ * \class ResponseCache
+ * \brief Cache of API responses revalidated with conditional requests
+ *
+ * Responses are keyed by the request URL without the access token, which is the last part
+ * of user API paths: the user id stays in the key, so different users never share entries,
+ * while the entries of a user survive renewals of the token. Every entry keeps the validators
+ * (ETag and Last-Modified) sent back with If-None-Match and If-Modified-Since headers, and the body
+ * decoded again when the server answers "304 Not Modified". If a directory is set, entries are also
+ * saved to it, readable by the owner only, and survive restarts, file names are hashes of the keys.
+ * Large bodies are kept in files of their own instead of memory: in the directory if it is set,
+ * in the temporary one otherwise. The least recently used entries are dropped together with their files
+ * when the cache is full.
+ */
+class ResponseCache {
+public:
+    /*!
+     * \brief Constructor
+     * \param capacity Maximal number of entries, in memory and in the directory
+     */
+    explicit ResponseCache(int capacity = 256) : capacity(capacity) {}
+
+    ~ResponseCache();
+
+    /*!
+     * \struct ResponseCache::Entry
+     * \brief Cached response with its validators
+     */
+    struct Entry {
+        QByteArray etag;
+        QByteArray lastModified;
+        QByteArray body; ///< Response body as it was received
+        bool cbor; ///< Whether the body is CBOR rather than JSON
+        QJsonDocument json; ///< Parsed body kept in memory, null if the body wasn't parsed whole
+        QString bodyFile; ///< File holding the body instead of body, empty if the body is in memory
+
+        /*!
+         * \brief Get the body, reading it from its file if it is kept there
+         */
+        QByteArray readBody() const;
+    };
+
+    /*!
+     * \brief Find a cached response
+     * \param url Request URL
+     * \param entry Entry to fill
+     * \return Whether the response is cached
+     */
+    bool lookup(const QUrl &url, Entry &entry);
+
+    /*!
+     * \brief Cache a response
+     * \param url Request URL
+     * \param entry Response with at least one validator, the cache takes over its body file
+     */
+    void store(const QUrl &url, const Entry &entry);
+
+    /*!
+     * \brief Create a file to write a large body to while it is being received, it is passed to store() then
+     * \return Opened file removed when it is destroyed unless it has been stored, nullptr if it can't be created
+     */
+    QTemporaryFile *createBodyFile();
+
+    /*!
+     * \brief Set the directory to persist entries to
+     * The entries saved to it before are used again, the oldest ones are removed if there are too many
+     * \param directory Directory path, empty to keep entries only in memory
+     */
+    void setDirectory(const QString &directory);
+
+private:
+    static QString key(const QUrl &url);
+
+    QString fileName(const QString &key) const;
+
+    QString bodyFileName(const QString &key) const;
+
+    void drop(const QString &key);
+
+    void use(const QString &key);
+
+    void trim();
+
+    QMutex mutex;
+    QHash<QString, Entry> entries;
+    QStringList order; ///< Keys of the entries in memory or in the directory, the least recently used first
+    QString directory;
+    int capacity;
+};
+
+
+#endif //ANTARCTICA_RESPONSECACHE_H
@@ -0,0 +1,281 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Incremental decoders for API responses received by chunks
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_STREAMDECODER_H
+#define ANTARCTICA_STREAMDECODER_H
+
+
+#include <functional>
+#include <memory>
+#include <QtCore/QByteArray>
+#include <QtCore/QCborStreamReader>
+#include <QtCore/QIODevice>
+#include <QtCore/QJsonObject>
+#include <QtCore/QVector>
+
+#include "api/utils/Base64Decoder.h"
+#include "api/utils/ResponseBody.h"
+
+/*!
+ * \class StreamDecoder
+ * \brief Base class for decoders consuming a response body while it is being downloaded
+ *
+ * A decoder takes the heavy part of the response out of the stream and keeps the rest of it
+ * (the skeleton) to check the response status in the usual way once the download is finished.
+ */
+class StreamDecoder {
+public:
+    /*!
+     * \brief Consume the next chunk of the response body
+     * \param chunk Bytes received since the previous call
+     */
+    virtual void feed(const QByteArray &chunk) = 0;
+
+    /*!
+     * \brief Get the response without the parts consumed by the decoder
+     * \return Response body in the format it has been received in
+     */
+    virtual ResponseBody skeleton() const = 0;
+
+    /*!
+     * \brief Forget everything fed so far to decode the response of a request sent again
+     * Must be called only if the decoder has produced nothing yet, e.g. for an error response
+     */
+    virtual void reset() = 0;
+
+    /*!
+     * \brief Switch to the CBOR body, called before the first chunk if the server has answered with CBOR
+     */
+    virtual void useCbor() = 0;
+
+    virtual ~StreamDecoder() = default;
+};
+
+/*!
+ * \class CborWalker
+ * \brief Incremental CBOR walker splitting the heavy parts out of a response
+ *
+ * The walker follows the structure of the document byte by byte and copies everything to the skeleton,
+ * except the "content" string of the object at the second level, which goes to the content callback,
+ * and elements of the list named by the root key, each of them goes to the element callback.
+ * These are left in the skeleton as an empty string and an empty list.
+ */
+class CborWalker {
+public:
+    using ContentCallback = std::function<void(const char *, int, bool)>;
+    using ElementCallback = std::function<void(const QByteArray &)>;
+
+    /*!
+     * \brief Constructor
+     * \param arrayName Name of the list to split, empty if there is no list
+     * \param onContent Callback receiving content bytes and whether the content is a text string
+     * \param onElement Callback receiving CBOR of every list element
+     */
+    CborWalker(QByteArray arrayName, ContentCallback onContent, ElementCallback onElement)
+            : arrayName(std::move(arrayName)), onContent(std::move(onContent)), onElement(std::move(onElement)) {}
+
+    /*!
+     * \brief Consume the next chunk of the document
+     * \param data Chunk bytes
+     * \param size Chunk size
+     */
+    void feed(const char *data, int size);
+
+    /*!
+     * \brief Get the document without the split parts
+     * \return CBOR document
+     */
+    inline const QByteArray &skeleton() const {
+        return cbor;
+    }
+
+    /*!
+     * \brief Check whether the document is malformed
+     */
+    inline bool failed() const {
+        return error;
+    }
+
+private:
+    enum Route {
+        Skeleton, Element, Content
+    };
+
+    struct Frame {
+        qint64 remaining; ///< items left, -1 for indefinite length
+        qint64 index;
+        Route route; ///< where items of the container go
+        Route own; ///< where the container header went
+        bool map;
+        bool list; ///< items are elements of the split list
+        bool dropBreak;
+        QByteArray key;
+    };
+
+    void header();
+    void payload(qint64 length, Route route, bool text, bool key);
+    void endPayload();
+    void complete();
+    void output(Route route, const char *data, int size);
+
+    QByteArray arrayName;
+    ContentCallback onContent;
+    ElementCallback onElement;
+    QByteArray cbor;
+    QByteArray element;
+    QByteArray head;
+    QByteArray keyText;
+    QVector<Frame> stack;
+    int headSize = 0;
+    qint64 payloadLeft = 0;
+    Route payloadRoute = Skeleton;
+    bool payloadText = false;
+    bool payloadKey = false;
+    bool error = false;
+};
+
+/*!
+ * \class ContentDecoder
+ * \brief Decoder of the file content response writing the content straight to a device
+ *
+ * The "content" field of the file object is base64 encoded twice: once by the server storage
+ * and once by the JSON serializer, so it goes through two chained base64 decoders
+ * and only the small rest of the response is kept in memory.
+ * A CBOR response carries the content as a byte string holding the file bytes as they are,
+ * so they are written to the device without decoding.
+ */
+class ContentDecoder : public StreamDecoder {
+public:
+    /*!
+     * \brief Constructor
+     * \param sink Opened device to write the decoded content to
+     */
+    explicit ContentDecoder(QIODevice *sink) : sink(sink) {}
+
+    void feed(const QByteArray &chunk) override;
+
+    ResponseBody skeleton() const override;
+
+    void reset() override {
+        *this = ContentDecoder(sink);
+    }
+
+    void useCbor() override;
+
+    /*!
+     * \brief Get number of content bytes written to the sink
+     */
+    inline qint64 written() const {
+        return bytesWritten;
+    }
+
+    /*!
+     * \brief Check whether writing to the sink has failed
+     */
+    inline bool failed() const {
+        return error;
+    }
+
+private:
+    void write(const QByteArray &encoded);
+
+    void store(const QByteArray &stored);
+
+    void output(const QByteArray &content);
+
+    QIODevice *sink;
+    std::shared_ptr<CborWalker> cbor;
+    QByteArray json;
+    QByteArray token;
+    QByteArray lastString;
+    QByteArray key;
+    int depth = 0;
+    int unicodeLeft = 0;
+    bool inString = false;
+    bool inContent = false;
+    bool escaped = false;
+    bool expectValue = false;
+    Base64Decoder jsonLayer;
+    Base64Decoder storageLayer;
+    qint64 bytesWritten = 0;
+    bool error = false;
+};
+
+/*!
+ * \class ListDecoder
+ * \brief Decoder of the entity list response passing every entity to a consumer as soon as it arrives
+ *
+ * Only the entity being received is kept in memory: every element of the list is parsed on its own
+ * when its closing brace arrives and it is left out of the skeleton, the list stays there empty.
+ * Elements of a CBOR response are read by the consumer straight from their bytes.
+ */
+class ListDecoder : public StreamDecoder {
+public:
+    using Consumer = std::function<void(const QJsonObject &)>;
+    using CborConsumer = std::function<void(QCborStreamReader &)>;
+
+    /*!
+     * \brief Constructor
+     * \param arrayName Name of the list in the root object: "files", "pkgs" or "repos"
+     * \param consumer Callback receiving JSON object of every entity
+     * \param cborConsumer Callback receiving the reader at every entity of a CBOR response, it must consume the entity
+     */
+    ListDecoder(QByteArray arrayName, Consumer consumer, CborConsumer cborConsumer)
+            : arrayName(std::move(arrayName)), consumer(std::move(consumer)), cborConsumer(std::move(cborConsumer)) {}
+
+    void feed(const QByteArray &chunk) override;
+
+    ResponseBody skeleton() const override;
+
+    void reset() override {
+        *this = ListDecoder(arrayName, consumer, cborConsumer);
+    }
+
+    void useCbor() override;
+
+private:
+    void append(const char *data, int size);
+
+    QByteArray arrayName;
+    Consumer consumer;
+    CborConsumer cborConsumer;
+    std::shared_ptr<CborWalker> cbor;
+    QByteArray json;
+    QByteArray element;
+    QByteArray token;
+    QByteArray lastString;
+    QByteArray key;
+    int depth = 0;
+    bool inArray = false;
+    bool inString = false;
+    bool escaped = false;
+    bool expectValue = false;
+};
+
+
+#endif //ANTARCTICA_STREAMDECODER_H
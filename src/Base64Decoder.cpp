@@ -0,0 +1,193 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Base64 decoder implementation
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "api/utils/Base64Decoder.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_VECTOR_KERNELS
+#include <immintrin.h>
+#endif
+
+static int base64Value(char ch) {
+    if (ch >= 'A' && ch <= 'Z') {
+        return ch - 'A';
+    } else if (ch >= 'a' && ch <= 'z') {
+        return ch - 'a' + 26;
+    } else if (ch >= '0' && ch <= '9') {
+        return ch - '0' + 52;
+    } else if (ch == '+') {
+        return 62;
+    } else if (ch == '/') {
+        return 63;
+    }
+    return -1;
+}
+
+/*!
+ * \brief Decoder of whole quads of clean base64
+ * Stops at the first block having a character outside the alphabet.
+ * \return Number of characters consumed, out gets 3 bytes for every 4 of them
+ */
+using Kernel = int (*)(const char *data, int size, char *out);
+
+#ifdef BASE64_VECTOR_KERNELS
+
+// Characters are validated and translated by their high nibbles with lookup tables (W. Muła, D. Lemire),
+// '/' is the only character sharing its nibble with another one ('+'), so it is fixed separately.
+// The 16 byte loop is inlined into the AVX2 kernel, so it is VEX encoded there and the kernel
+// doesn't pay for switching to legacy SSE at the end of every run
+
+__attribute__((target("ssse3"), always_inline))
+static inline int decodeBlocks(const char *data, int size, char *out) {
+    const __m128i lowerBound = _mm_setr_epi8(1, 0, 0x2b, 0x30, 0x41, 0x50, 0x61, 0x70, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i upperBound = _mm_setr_epi8(0, 1, 0x2b, 0x39, 0x4f, 0x5a, 0x6f, 0x7a, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i shift = _mm_setr_epi8(0, 0, 0x3e - 0x2b, 0x34 - 0x30, 0x00 - 0x41, 0x0f - 0x50, 0x1a - 0x61,
+                                        0x29 - 0x70, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    int consumed = 0;
+    while (size - consumed >= 16) {
+        auto input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + consumed));
+        auto nibbles = _mm_and_si128(_mm_srli_epi32(input, 4), _mm_set1_epi8(0x0f));
+        auto slash = _mm_cmpeq_epi8(input, _mm_set1_epi8('/'));
+        auto outside = _mm_or_si128(_mm_cmplt_epi8(input, _mm_shuffle_epi8(lowerBound, nibbles)),
+                                    _mm_cmpgt_epi8(input, _mm_shuffle_epi8(upperBound, nibbles)));
+        if (_mm_movemask_epi8(_mm_andnot_si128(slash, outside))) {
+            break;
+        }
+        auto values = _mm_add_epi8(_mm_add_epi8(input, _mm_shuffle_epi8(shift, nibbles)),
+                                   _mm_and_si128(slash, _mm_set1_epi8(-3)));
+
+        // 4 six bit values are merged into 3 bytes in every 32 bit lane, then lanes are packed together
+        auto merged = _mm_madd_epi16(_mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140)),
+                                     _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_shuffle_epi8(merged, pack));
+        consumed += 16;
+        out += 12;
+    }
+    return consumed;
+}
+
+__attribute__((target("ssse3")))
+static int decodeSsse3(const char *data, int size, char *out) {
+    return decodeBlocks(data, size, out);
+}
+
+__attribute__((target("avx2")))
+static int decodeAvx2(const char *data, int size, char *out) {
+    const __m256i lowerBound = _mm256_broadcastsi128_si256(
+            _mm_setr_epi8(1, 0, 0x2b, 0x30, 0x41, 0x50, 0x61, 0x70, 1, 1, 1, 1, 1, 1, 1, 1));
+    const __m256i upperBound = _mm256_broadcastsi128_si256(
+            _mm_setr_epi8(0, 1, 0x2b, 0x39, 0x4f, 0x5a, 0x6f, 0x7a, 0, 0, 0, 0, 0, 0, 0, 0));
+    const __m256i shift = _mm256_broadcastsi128_si256(
+            _mm_setr_epi8(0, 0, 0x3e - 0x2b, 0x34 - 0x30, 0x00 - 0x41, 0x0f - 0x50, 0x1a - 0x61, 0x29 - 0x70,
+                          0, 0, 0, 0, 0, 0, 0, 0));
+    const __m256i pack = _mm256_broadcastsi128_si256(
+            _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    int consumed = 0;
+    while (size - consumed >= 32) {
+        auto input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + consumed));
+        auto nibbles = _mm256_and_si256(_mm256_srli_epi32(input, 4), _mm256_set1_epi8(0x0f));
+        auto slash = _mm256_cmpeq_epi8(input, _mm256_set1_epi8('/'));
+        auto outside = _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_shuffle_epi8(lowerBound, nibbles), input),
+                                       _mm256_cmpgt_epi8(input, _mm256_shuffle_epi8(upperBound, nibbles)));
+        if (_mm256_movemask_epi8(_mm256_andnot_si256(slash, outside))) {
+            break;
+        }
+        auto values = _mm256_add_epi8(_mm256_add_epi8(input, _mm256_shuffle_epi8(shift, nibbles)),
+                                      _mm256_and_si256(slash, _mm256_set1_epi8(-3)));
+
+        auto merged = _mm256_madd_epi16(_mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140)),
+                                        _mm256_set1_epi32(0x00011000));
+        auto packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(merged, pack), lanes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), packed);
+        consumed += 32;
+        out += 24;
+    }
+    return consumed + decodeBlocks(data + consumed, size - consumed, out);
+}
+
+#endif
+
+static Kernel selectKernel() {
+#ifdef BASE64_VECTOR_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return decodeAvx2;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        return decodeSsse3;
+    }
+#endif
+    return nullptr;
+}
+
+int Base64Decoder::decode(const char *data, int size, char *out) {
+    static const Kernel kernel = selectKernel();
+
+    int written = 0;
+    int i = 0;
+    while (i < size) {
+        if (kernel && bits == 0) { // nothing is left in the buffer, so whole quads follow
+            int consumed = kernel(data + i, size - i, out + written);
+            i += consumed;
+            written += consumed / 4 * 3;
+        }
+
+        // the kernel has stopped at a character outside the alphabet, at a quad split between two parts
+        // or at the tail shorter than a block; once such a character is skipped or the split quad is completed,
+        // the input goes back to the kernel at the next quad
+        bool resumable = bits != 0;
+        for (; i < size; ++i) {
+            if (kernel && resumable && bits == 0) {
+                break;
+            }
+            int value = base64Value(data[i]);
+            if (value < 0) {
+                resumable = true;
+                continue;
+            }
+            buffer = (buffer << 6) | static_cast<uint>(value);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                out[written++] = static_cast<char>(buffer >> bits);
+                buffer &= (1u << bits) - 1;
+            }
+        }
+    }
+    return written;
+}
+
+QByteArray Base64Decoder::decode(const char *data, int size) {
+    QByteArray result(bufferSize(size), Qt::Uninitialized);
+    result.resize(decode(data, size, result.data()));
+    return result;
+}
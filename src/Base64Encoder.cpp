@@ -0,0 +1,161 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Vectorized base64 encoder implementation
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "api/utils/Base64Encoder.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_VECTOR_KERNELS
+#include <immintrin.h>
+#endif
+
+static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*!
+ * \brief Encoder of whole blocks
+ * Stops when less than a block is left, the block may read a few bytes beyond the ones it encodes.
+ * \return Number of bytes consumed, out gets 4 characters for every 3 of them
+ */
+using Kernel = int (*)(const char *data, int size, char *out);
+
+#ifdef BASE64_VECTOR_KERNELS
+
+// Every 3 bytes are spread over a 32 bit lane and split into 4 six bit values by multiplications,
+// the values are translated by the offsets of their alphabet ranges looked up with pshufb (W. Muła, D. Lemire).
+// The 12 byte loop is inlined into the AVX2 kernel to keep it VEX encoded there
+
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i encodeLanes(__m128i input) {
+    const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+    auto lanes = _mm_shuffle_epi8(input, spread);
+    auto high = _mm_mulhi_epu16(_mm_and_si128(lanes, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    auto low = _mm_mullo_epi16(_mm_and_si128(lanes, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    auto values = _mm_or_si128(high, low);
+
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    auto range = _mm_subs_epu8(values, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), values), _mm_set1_epi8(13)));
+    return _mm_add_epi8(values, _mm_shuffle_epi8(offsets, range));
+}
+
+__attribute__((target("ssse3"), always_inline))
+static inline int encodeBlocks(const char *data, int size, char *out) {
+    int consumed = 0;
+    while (size - consumed >= 16) {
+        auto input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + consumed));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), encodeLanes(input));
+        consumed += 12;
+        out += 16;
+    }
+    return consumed;
+}
+
+__attribute__((target("ssse3")))
+static int encodeSsse3(const char *data, int size, char *out) {
+    return encodeBlocks(data, size, out);
+}
+
+__attribute__((target("avx2")))
+static int encodeAvx2(const char *data, int size, char *out) {
+    const __m256i spread = _mm256_broadcastsi128_si256(
+            _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const __m256i offsets = _mm256_broadcastsi128_si256(
+            _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                          '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0));
+
+    int consumed = 0;
+    while (size - consumed >= 28) { // the upper lane takes 12 bytes loaded from the 13th one
+        auto input = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + consumed))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + consumed + 12)), 1);
+        auto lanes = _mm256_shuffle_epi8(input, spread);
+        auto high = _mm256_mulhi_epu16(_mm256_and_si256(lanes, _mm256_set1_epi32(0x0fc0fc00)),
+                                       _mm256_set1_epi32(0x04000040));
+        auto low = _mm256_mullo_epi16(_mm256_and_si256(lanes, _mm256_set1_epi32(0x003f03f0)),
+                                      _mm256_set1_epi32(0x01000010));
+        auto values = _mm256_or_si256(high, low);
+
+        auto range = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+        range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), values),
+                                                        _mm256_set1_epi8(13)));
+        auto chars = _mm256_add_epi8(values, _mm256_shuffle_epi8(offsets, range));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), chars);
+        consumed += 24;
+        out += 32;
+    }
+    return consumed + encodeBlocks(data + consumed, size - consumed, out);
+}
+
+#endif
+
+static Kernel selectKernel() {
+#ifdef BASE64_VECTOR_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return encodeAvx2;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        return encodeSsse3;
+    }
+#endif
+    return nullptr;
+}
+
+int Base64Encoder::encode(const char *data, int size, char *out) {
+    static const Kernel kernel = selectKernel();
+
+    int i = kernel ? kernel(data, size, out) : 0;
+    int written = i / 3 * 4;
+    auto bytes = reinterpret_cast<const uchar *>(data);
+    for (; size - i >= 3; i += 3) {
+        uint triple = (uint(bytes[i]) << 16) | (uint(bytes[i + 1]) << 8) | bytes[i + 2];
+        out[written++] = alphabet[triple >> 18];
+        out[written++] = alphabet[(triple >> 12) & 0x3f];
+        out[written++] = alphabet[(triple >> 6) & 0x3f];
+        out[written++] = alphabet[triple & 0x3f];
+    }
+    if (i < size) {
+        uint triple = uint(bytes[i]) << 16;
+        if (i + 1 < size) {
+            triple |= uint(bytes[i + 1]) << 8;
+        }
+        out[written++] = alphabet[triple >> 18];
+        out[written++] = alphabet[(triple >> 12) & 0x3f];
+        out[written++] = i + 1 < size ? alphabet[(triple >> 6) & 0x3f] : '=';
+        out[written++] = '=';
+    }
+    return written;
+}
+
+QByteArray Base64Encoder::encode(const QByteArray &data) {
+    QByteArray result(bufferSize(data.size()), Qt::Uninitialized);
+    result.resize(encode(data.constData(), data.size(), result.data()));
+    return result;
+}
@@ -0,0 +1,73 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Entity cache implementation
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/QMutexLocker>
+
+#include "api/utils/EntityCache.h"
+
+bool EntityCache::lookup(int id, QJsonObject &json, QByteArray &cbor) {
+    QMutexLocker locker(&mutex);
+    auto entry = entries.object(id);
+    if (!entry || entry->expires.hasExpired()) {
+        entries.remove(id);
+        ++misses;
+        return false;
+    }
+    json = entry->json;
+    cbor = entry->cbor;
+    ++hits;
+    return true;
+}
+
+quint64 EntityCache::version() {
+    QMutexLocker locker(&mutex);
+    return invalidations;
+}
+
+void EntityCache::store(int id, const QJsonObject &json, const QByteArray &cbor, int ttl, quint64 requested) {
+    if (ttl <= 0) {
+        return;
+    }
+    QMutexLocker locker(&mutex);
+    if (requested != invalidations) { // a write has happened while the entity was being got
+        return;
+    }
+    entries.insert(id, new Entry{json, cbor, QDeadlineTimer(ttl)});
+}
+
+void EntityCache::invalidate(int id) {
+    QMutexLocker locker(&mutex);
+    entries.remove(id);
+    ++invalidations;
+}
+
+EntityCache::Stats EntityCache::stats() {
+    QMutexLocker locker(&mutex);
+    return Stats{hits, misses};
+}
@@ -0,0 +1,77 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Gzip encoder implementation
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <zlib.h>
+
+#include "api/utils/GzipEncoder.h"
+
+static const int gzipWindowBits = 15 + 16; // maximal window with a gzip header instead of the zlib one
+
+GzipEncoder::GzipEncoder(int level) : stream(new z_stream) {
+    stream->zalloc = Z_NULL;
+    stream->zfree = Z_NULL;
+    stream->opaque = Z_NULL;
+    error = deflateInit2(stream.get(), level, Z_DEFLATED, gzipWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK;
+}
+
+GzipEncoder::~GzipEncoder() {
+    if (!error) {
+        deflateEnd(stream.get());
+    }
+}
+
+QByteArray GzipEncoder::encode(const char *data, int size) {
+    return run(data, size, Z_NO_FLUSH);
+}
+
+QByteArray GzipEncoder::finish() {
+    return run(nullptr, 0, Z_FINISH);
+}
+
+QByteArray GzipEncoder::run(const char *data, int size, int flush) {
+    QByteArray result;
+    if (error) {
+        return result;
+    }
+
+    stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream->avail_in = static_cast<uInt>(size);
+    char buffer[16 * 1024];
+    do {
+        stream->next_out = reinterpret_cast<Bytef *>(buffer);
+        stream->avail_out = sizeof(buffer);
+        auto status = deflate(stream.get(), flush);
+        if (status == Z_STREAM_ERROR) {
+            error = true;
+            return QByteArray();
+        }
+        result.append(buffer, static_cast<int>(sizeof(buffer) - stream->avail_out));
+    } while (stream->avail_out == 0);
+    return result;
+}
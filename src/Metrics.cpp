@@ -0,0 +1,234 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Request metrics implementation
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QStringList>
+
+#include "api/Wrapper.h"
+#include "api/utils/Metrics.h"
+
+const QVector<double> &Metrics::Histogram::bounds() {
+    static const QVector<double> msecs{1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+    return msecs;
+}
+
+void Metrics::Histogram::add(double msecs) {
+    auto &limits = bounds();
+    int bucket = 0;
+    while (bucket < limits.size() && msecs > limits[bucket]) {
+        ++bucket;
+    }
+    ++buckets[bucket];
+    ++count;
+    sum += msecs;
+}
+
+QString Metrics::endpoint(const QString &method, const QString &path, const QString &token) {
+    QStringList parts;
+    for (auto &&segment : path.split('/')) {
+        if (segment.isEmpty() || (!token.isEmpty() && segment == token)) {
+            continue;
+        }
+        bool word = true;
+        for (auto &&ch : segment) {
+            word = word && (ch.isLower() || ch == '_');
+        }
+        parts << (word ? segment : "{id}");
+    }
+    // "/api/user/{id}/" is the same for all the sections
+    if (parts.value(0) == "api") {
+        parts.removeFirst();
+    }
+    if (parts.size() > 2 && parts[0] == "user") {
+        parts = parts.mid(2);
+    }
+    return method + " " + parts.join('/');
+}
+
+QString Metrics::phaseName(Phase phase) {
+    switch (phase) {
+        case Queue:
+            return "queue";
+        case Connect:
+            return "connect";
+        case FirstByte:
+            return "first_byte";
+        case Transfer:
+            return "transfer";
+        case Parse:
+            return "parse";
+        case Construction:
+            return "construction";
+        default:
+            return "unknown";
+    }
+}
+
+QString Metrics::errorName(int code) {
+    switch (static_cast<Response::Error::Code>(code)) {
+        case Response::Error::Code::NotFound:
+            return "NotFound";
+        case Response::Error::Code::InvalidToken:
+            return "InvalidToken";
+        case Response::Error::Code::FormParsingError:
+            return "FormParsingError";
+        case Response::Error::Code::AlreadyExists:
+            return "AlreadyExists";
+        case Response::Error::Code::WrongLogin:
+            return "WrongLogin";
+        case Response::Error::Code::OK:
+            return "OK";
+        case Response::Error::Code::NoResponse:
+            return "NoResponse";
+        case Response::Error::Code::MissingFields:
+            return "MissingFields";
+        default:
+            return QString::number(code);
+    }
+}
+
+void Metrics::record(const QString &endpoint, Phase phase, qint64 nsecs) {
+    QMutexLocker locker(&mutex);
+    data.endpoints[endpoint].phases[phase].add(nsecs / 1e6);
+}
+
+void Metrics::finished(const QString &endpoint, qint64 bytesIn, qint64 bytesOut) {
+    QMutexLocker locker(&mutex);
+    auto &metrics = data.endpoints[endpoint];
+    ++metrics.requests;
+    metrics.bytesIn += static_cast<quint64>(qMax<qint64>(0, bytesIn));
+    metrics.bytesOut += static_cast<quint64>(qMax<qint64>(0, bytesOut));
+}
+
+void Metrics::failed(const QString &endpoint, int code) {
+    QMutexLocker locker(&mutex);
+    ++data.endpoints[endpoint].errors[code];
+}
+
+Metrics::Snapshot Metrics::snapshot() {
+    QMutexLocker locker(&mutex);
+    return data;
+}
+
+QJsonObject Metrics::Snapshot::toJson() const {
+    QJsonObject endpointsJson;
+    for (auto it = endpoints.begin(); it != endpoints.end(); ++it) {
+        auto &metrics = it.value();
+
+        QJsonObject errorsJson;
+        for (auto error = metrics.errors.begin(); error != metrics.errors.end(); ++error) {
+            errorsJson[errorName(error.key())] = static_cast<double>(error.value());
+        }
+
+        QJsonObject phasesJson;
+        for (int phase = 0; phase < PhaseCount; ++phase) {
+            auto &histogram = metrics.phases[phase];
+            if (histogram.count == 0) {
+                continue;
+            }
+            QJsonArray bucketsJson;
+            for (int bucket = 0; bucket < histogram.buckets.size(); ++bucket) {
+                QJsonObject bucketJson;
+                if (bucket < Histogram::bounds().size()) {
+                    bucketJson["le"] = Histogram::bounds()[bucket];
+                }
+                bucketJson["count"] = static_cast<double>(histogram.buckets[bucket]);
+                bucketsJson.append(bucketJson);
+            }
+            QJsonObject histogramJson;
+            histogramJson["count"] = static_cast<double>(histogram.count);
+            histogramJson["sum_ms"] = histogram.sum;
+            histogramJson["buckets"] = bucketsJson;
+            phasesJson[phaseName(static_cast<Phase>(phase))] = histogramJson;
+        }
+
+        QJsonObject endpointJson;
+        endpointJson["requests"] = static_cast<double>(metrics.requests);
+        endpointJson["bytes_in"] = static_cast<double>(metrics.bytesIn);
+        endpointJson["bytes_out"] = static_cast<double>(metrics.bytesOut);
+        endpointJson["errors"] = errorsJson;
+        endpointJson["phases"] = phasesJson;
+        endpointsJson[it.key()] = endpointJson;
+    }
+
+    QJsonObject json;
+    json["endpoints"] = endpointsJson;
+    return json;
+}
+
+QByteArray Metrics::Snapshot::toPrometheus() const {
+    QByteArray text;
+    auto label = [](const QString &endpoint) {
+        return QString("endpoint=\"%1\"").arg(endpoint).toUtf8();
+    };
+
+    text += "# TYPE icebreaker_requests_total counter\n";
+    for (auto it = endpoints.begin(); it != endpoints.end(); ++it) {
+        text += "icebreaker_requests_total{" + label(it.key()) + "} " + QByteArray::number(it->requests) + "\n";
+    }
+    text += "# TYPE icebreaker_errors_total counter\n";
+    for (auto it = endpoints.begin(); it != endpoints.end(); ++it) {
+        for (auto error = it->errors.begin(); error != it->errors.end(); ++error) {
+            text += "icebreaker_errors_total{" + label(it.key()) + ",code=\"" + errorName(error.key()).toUtf8()
+                    + "\"} " + QByteArray::number(error.value()) + "\n";
+        }
+    }
+    text += "# TYPE icebreaker_received_bytes_total counter\n";
+    for (auto it = endpoints.begin(); it != endpoints.end(); ++it) {
+        text += "icebreaker_received_bytes_total{" + label(it.key()) + "} " + QByteArray::number(it->bytesIn) + "\n";
+    }
+    text += "# TYPE icebreaker_sent_bytes_total counter\n";
+    for (auto it = endpoints.begin(); it != endpoints.end(); ++it) {
+        text += "icebreaker_sent_bytes_total{" + label(it.key()) + "} " + QByteArray::number(it->bytesOut) + "\n";
+    }
+
+    text += "# TYPE icebreaker_phase_seconds histogram\n";
+    for (auto it = endpoints.begin(); it != endpoints.end(); ++it) {
+        for (int phase = 0; phase < PhaseCount; ++phase) {
+            auto &histogram = it->phases[phase];
+            if (histogram.count == 0) {
+                continue;
+            }
+            auto labels = label(it.key()) + ",phase=\"" + phaseName(static_cast<Phase>(phase)).toUtf8() + "\"";
+            quint64 cumulative = 0;
+            for (int bucket = 0; bucket < histogram.buckets.size(); ++bucket) {
+                cumulative += histogram.buckets[bucket];
+                auto bound = bucket < Histogram::bounds().size()
+                             ? QByteArray::number(Histogram::bounds()[bucket] / 1000)
+                             : QByteArray("+Inf");
+                text += "icebreaker_phase_seconds_bucket{" + labels + ",le=\"" + bound + "\"} "
+                        + QByteArray::number(cumulative) + "\n";
+            }
+            text += "icebreaker_phase_seconds_sum{" + labels + "} " + QByteArray::number(histogram.sum / 1000) + "\n";
+            text += "icebreaker_phase_seconds_count{" + labels + "} " + QByteArray::number(histogram.count) + "\n";
+        }
+    }
+    return text;
+}
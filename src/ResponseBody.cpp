@@ -0,0 +1,96 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief API response body implementation
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/QCborArray>
+#include <QtCore/QCborMap>
+#include <QtCore/QJsonArray>
+
+#include "api/utils/Base64Encoder.h"
+#include "api/utils/ResponseBody.h"
+
+QJsonValue cborToJson(const QCborValue &value) {
+    if (value.isByteArray()) {
+        return QString::fromLatin1(Base64Encoder::encode(value.toByteArray()));
+    } else if (value.isTag()) {
+        return cborToJson(value.taggedValue());
+    } else if (value.isArray()) {
+        QJsonArray array;
+        for (const QCborValue item : value.toArray()) {
+            array.append(cborToJson(item));
+        }
+        return array;
+    } else if (value.isMap()) {
+        QJsonObject object;
+        auto map = value.toMap();
+        for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+            auto key = it.key().isString() ? it.key().toString() : it.key().toDiagnosticNotation();
+            object.insert(key, cborToJson(it.value()));
+        }
+        return object;
+    }
+    return value.toJsonValue();
+}
+
+ResponseBody::ResponseBody(const QByteArray &body, bool cbor)
+        : document(cbor ? QJsonDocument() : QJsonDocument::fromJson(body)), bytes(cbor ? body : QByteArray()),
+          cbor(cbor), response(document.object()) {
+    if (cbor) {
+        response = read(nullptr);
+    }
+}
+
+Response ResponseBody::read(const Reader &readValue) const {
+    if (!cbor) {
+        return response;
+    }
+    QCborStreamReader reader(bytes);
+    return Response(reader, readValue);
+}
+
+QJsonValue ResponseBody::value(const QString &key) const {
+    if (!cbor) {
+        return document[key];
+    }
+    QJsonValue found(QJsonValue::Undefined);
+    read([&key, &found](const QString &name, QCborStreamReader &reader) {
+        if (name == key && found.isUndefined()) {
+            found = cborToJson(QCborValue::fromCbor(reader));
+        } else {
+            reader.next();
+        }
+    });
+    return found;
+}
+
+QString ResponseBody::toString() const {
+    if (cbor) {
+        return QCborValue::fromCbor(bytes).toDiagnosticNotation();
+    }
+    return QString::fromUtf8(document.toJson(QJsonDocument::Compact));
+}
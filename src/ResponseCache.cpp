@@ -0,0 +1,229 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Response cache implementation
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QSaveFile>
+
+#include "api/utils/ResponseCache.h"
+
+ResponseCache::~ResponseCache() {
+    if (directory.isEmpty()) { // temporary body files are of no use to anyone else
+        for (auto &&entry : entries) {
+            if (!entry.bodyFile.isEmpty()) {
+                QFile::remove(entry.bodyFile);
+            }
+        }
+    }
+}
+
+QByteArray ResponseCache::Entry::readBody() const {
+    if (bodyFile.isEmpty()) {
+        return body;
+    }
+    QFile file(bodyFile);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+bool ResponseCache::lookup(const QUrl &url, Entry &entry) {
+    QMutexLocker locker(&mutex);
+    auto cacheKey = key(url);
+    auto found = entries.find(cacheKey);
+    if (found != entries.end()) {
+        if (!found->bodyFile.isEmpty() && !QFile::exists(found->bodyFile)) {
+            drop(cacheKey);
+            return false;
+        }
+        entry = found.value();
+        use(cacheKey);
+        return true;
+    }
+    if (directory.isEmpty() || !order.contains(cacheKey)) {
+        return false;
+    }
+
+    // a line of JSON with the validators followed by the body, unless it is in a file of its own
+    QFile file(fileName(cacheKey));
+    if (!file.open(QIODevice::ReadOnly)) {
+        order.removeOne(cacheKey);
+        return false;
+    }
+    auto saved = QJsonDocument::fromJson(file.readLine()).object();
+    if (!saved["format"].isString()) {
+        file.remove();
+        order.removeOne(cacheKey);
+        return false;
+    }
+    entry.etag = saved["etag"].toString().toUtf8();
+    entry.lastModified = saved["last_modified"].toString().toUtf8();
+    entry.cbor = saved["format"].toString() == "cbor";
+    entry.json = QJsonDocument();
+    if (saved["body_file"].toBool()) {
+        entry.body = QByteArray();
+        entry.bodyFile = bodyFileName(cacheKey);
+        if (!QFile::exists(entry.bodyFile)) {
+            file.close();
+            drop(cacheKey);
+            return false;
+        }
+    } else {
+        entry.body = file.readAll();
+        entry.bodyFile = QString();
+    }
+    entries.insert(cacheKey, entry);
+    use(cacheKey);
+    return true;
+}
+
+void ResponseCache::store(const QUrl &url, const Entry &entry) {
+    QMutexLocker locker(&mutex);
+    auto cacheKey = key(url);
+    auto stored = entry;
+    if (!stored.bodyFile.isEmpty()) {
+        // named after the key, so the body of a later response for the same URL replaces it
+        auto target = bodyFileName(cacheKey);
+        if (target != stored.bodyFile) {
+            QFile::remove(target);
+            if (!QFile::rename(stored.bodyFile, target)) {
+                QFile::remove(stored.bodyFile);
+                return;
+            }
+            stored.bodyFile = target;
+        }
+    } else {
+        QFile::remove(bodyFileName(cacheKey));
+    }
+    entries.insert(cacheKey, stored);
+    use(cacheKey);
+    if (directory.isEmpty()) {
+        return;
+    }
+
+    QJsonObject saved;
+    saved["etag"] = QString::fromUtf8(entry.etag);
+    saved["last_modified"] = QString::fromUtf8(entry.lastModified);
+    saved["format"] = entry.cbor ? "cbor" : "json";
+    saved["body_file"] = !stored.bodyFile.isEmpty();
+
+    QSaveFile file(fileName(cacheKey));
+    if (file.open(QIODevice::WriteOnly)) {
+        // before any content is written, so the responses are never readable by others
+        file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+        file.write(QJsonDocument(saved).toJson(QJsonDocument::Compact) + '\n');
+        if (stored.bodyFile.isEmpty()) {
+            file.write(entry.body);
+        }
+        file.commit();
+    }
+}
+
+QTemporaryFile *ResponseCache::createBodyFile() {
+    QMutexLocker locker(&mutex);
+    auto file = new QTemporaryFile(QDir(directory.isEmpty() ? QDir::tempPath() : directory)
+                                           .filePath("icebreaker-XXXXXX.partial"));
+    if (!file->open()) {
+        delete file;
+        return nullptr;
+    }
+    return file;
+}
+
+void ResponseCache::setDirectory(const QString &path) {
+    QMutexLocker locker(&mutex);
+    if (directory.isEmpty()) {
+        for (auto &&entry : entries) {
+            if (!entry.bodyFile.isEmpty()) {
+                QFile::remove(entry.bodyFile);
+            }
+        }
+    }
+    directory = path;
+    entries.clear();
+    order.clear();
+    if (directory.isEmpty()) {
+        return;
+    }
+
+    if (!QDir(directory).exists()) {
+        QDir().mkpath(directory);
+        QFile::setPermissions(directory, QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner);
+    }
+    auto saved = QDir(directory).entryInfoList({"*.response"}, QDir::Files, QDir::Time | QDir::Reversed);
+    for (auto &&info : saved) {
+        order << info.completeBaseName();
+    }
+    trim();
+}
+
+QString ResponseCache::key(const QUrl &url) {
+    // the access token is the last part of user API paths
+    auto keyUrl = url.path().startsWith("/api/user/") ? url.adjusted(QUrl::RemoveFilename) : url;
+    return QCryptographicHash::hash(keyUrl.toEncoded(), QCryptographicHash::Sha1).toHex();
+}
+
+QString ResponseCache::fileName(const QString &cacheKey) const {
+    return QDir(directory).filePath(cacheKey + ".response");
+}
+
+QString ResponseCache::bodyFileName(const QString &cacheKey) const {
+    if (directory.isEmpty()) { // other processes of the same user would have the same keys
+        return QDir::temp().filePath(
+                QString("icebreaker-%1-%2.body").arg(QCoreApplication::applicationPid()).arg(cacheKey));
+    }
+    return QDir(directory).filePath(cacheKey + ".body");
+}
+
+void ResponseCache::drop(const QString &cacheKey) {
+    order.removeOne(cacheKey);
+    auto entry = entries.take(cacheKey);
+    if (!entry.bodyFile.isEmpty()) {
+        QFile::remove(entry.bodyFile);
+    }
+    if (!directory.isEmpty()) {
+        QFile::remove(fileName(cacheKey));
+        QFile::remove(bodyFileName(cacheKey));
+    }
+}
+
+void ResponseCache::use(const QString &cacheKey) {
+    order.removeOne(cacheKey);
+    order << cacheKey;
+    trim();
+}
+
+void ResponseCache::trim() {
+    while (order.size() > qMax(1, capacity)) {
+        drop(order.first());
+    }
+}
@@ -0,0 +1,434 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Incremental response decoders implementation
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/QJsonDocument>
+
+#include "api/utils/StreamDecoder.h"
+
+void CborWalker::feed(const char *data, int size) {
+    int i = 0;
+    while (i < size && !error) {
+        if (payloadLeft > 0) {
+            auto length = static_cast<int>(qMin<qint64>(payloadLeft, size - i));
+            output(payloadRoute, data + i, length);
+            if (payloadKey && keyText.size() <= 16) { // keys we look for are short, longer strings never match
+                keyText.append(data + i, qMin(length, 17));
+            }
+            payloadLeft -= length;
+            i += length;
+            if (payloadLeft == 0) {
+                endPayload();
+            }
+            continue;
+        }
+
+        head.append(data[i++]);
+        if (head.size() == 1) {
+            int info = head[0] & 0x1f;
+            if (info >= 28 && info <= 30) { // reserved by the format
+                error = true;
+                return;
+            }
+            headSize = 1 + (info < 24 || info == 31 ? 0 : 1 << (info - 24));
+        }
+        if (head.size() == headSize) {
+            header();
+            head.clear();
+        }
+    }
+}
+
+void CborWalker::header() {
+    auto initial = static_cast<uchar>(head[0]);
+    int major = initial >> 5;
+    int info = initial & 0x1f;
+    bool indefinite = info == 31;
+    qint64 value = info;
+    if (info >= 24 && !indefinite) {
+        value = 0;
+        for (int i = 1; i < head.size(); ++i) {
+            value = (value << 8) | static_cast<uchar>(head[i]);
+        }
+    }
+    if (major >= 2 && major <= 5 && value < 0) { // lengths beyond 2^63 are never real
+        error = true;
+        return;
+    }
+
+    Frame *parent = stack.isEmpty() ? nullptr : &stack.last();
+    if (major == 7 && indefinite) { // break code closing an indefinite length item
+        if (!parent || parent->remaining != -1) {
+            error = true;
+            return;
+        }
+        if (!parent->dropBreak) {
+            output(parent->own, head.constData(), head.size());
+        }
+        stack.removeLast();
+        complete();
+        return;
+    }
+
+    Route route = parent ? parent->route : Skeleton;
+    if (major == 6) { // a tag is a prefix of the item which follows
+        output(route, head.constData(), head.size());
+        return;
+    }
+
+    bool isKey = parent && parent->map && parent->index % 2 == 0;
+    bool isValue = parent && parent->map && !isKey;
+    if (isKey && major != 3) {
+        parent->key.clear();
+    }
+
+    if (route == Skeleton && isValue && onElement && stack.size() == 1 && major == 4 && parent->key == arrayName) {
+        cbor.append('\x80');
+        if (indefinite || value > 0) {
+            stack.append({indefinite ? -1 : value, 0, Element, Skeleton, false, true, true, {}});
+        } else {
+            complete();
+        }
+        return;
+    }
+    if (route == Skeleton && isValue && onContent && stack.size() == 2 && (major == 2 || major == 3)
+        && parent->key == "content") {
+        cbor.append(major == 2 ? '\x40' : '\x60');
+        if (indefinite) {
+            stack.append({-1, 0, Content, Skeleton, false, false, true, {}});
+        } else {
+            payload(value, Content, major == 3, false);
+        }
+        return;
+    }
+
+    if (route != Content) { // headers of the content string chunks are dropped
+        output(route, head.constData(), head.size());
+    }
+    switch (major) {
+        case 2:
+        case 3:
+            if (indefinite) {
+                stack.append({-1, 0, route, route, false, false, false, {}});
+            } else {
+                payload(value, route, major == 3, isKey && major == 3);
+            }
+            break;
+        case 4:
+        case 5:
+            if (indefinite || value > 0) {
+                stack.append({indefinite ? -1 : (major == 5 ? value * 2 : value), 0, route, route, major == 5,
+                              false, false, {}});
+            } else {
+                complete();
+            }
+            break;
+        default:
+            complete();
+            break;
+    }
+}
+
+void CborWalker::payload(qint64 length, Route route, bool text, bool key) {
+    payloadLeft = length;
+    payloadRoute = route;
+    payloadText = text;
+    payloadKey = key;
+    keyText.clear();
+    if (length == 0) {
+        endPayload();
+    }
+}
+
+void CborWalker::endPayload() {
+    if (payloadKey) {
+        stack.last().key = keyText;
+        payloadKey = false;
+    }
+    complete();
+}
+
+void CborWalker::complete() {
+    while (!stack.isEmpty()) {
+        Frame &parent = stack.last();
+        if (parent.list) {
+            onElement(element);
+            element.clear();
+        }
+        ++parent.index;
+        if (parent.remaining < 0 || --parent.remaining > 0) {
+            return;
+        }
+        stack.removeLast(); // the container is complete as well
+    }
+}
+
+void CborWalker::output(Route route, const char *data, int size) {
+    switch (route) {
+        case Skeleton:
+            cbor.append(data, size);
+            break;
+        case Element:
+            element.append(data, size);
+            break;
+        case Content:
+            onContent(data, size, payloadText);
+            break;
+    }
+}
+
+void ContentDecoder::feed(const QByteArray &chunk) {
+    if (cbor) {
+        cbor->feed(chunk.constData(), chunk.size());
+        return;
+    }
+
+    QByteArray encoded;
+    const char *data = chunk.constData();
+    const int size = chunk.size();
+
+    for (int i = 0; i < size; ++i) {
+        char ch = data[i];
+
+        if (inContent) {
+            if (unicodeLeft > 0) { // skip \uXXXX escapes, they never carry base64 characters
+                --unicodeLeft;
+            } else if (escaped) {
+                escaped = false;
+                if (ch == 'u') {
+                    unicodeLeft = 4;
+                } else if (ch == '/') { // the only escape carrying a base64 character, "\n" and others are dropped
+                    encoded.append(ch);
+                }
+            } else if (ch == '\\') {
+                escaped = true;
+            } else if (ch == '"') {
+                inContent = false;
+                json.append(ch);
+            } else {
+                int end = i;
+                while (end < size && data[end] != '"' && data[end] != '\\') {
+                    ++end;
+                }
+                encoded.append(data + i, end - i);
+                i = end - 1;
+            }
+            continue;
+        }
+
+        json.append(ch);
+        if (inString) {
+            if (escaped) {
+                escaped = false;
+            } else if (ch == '\\') {
+                escaped = true;
+            } else if (ch == '"') {
+                inString = false;
+                lastString = token;
+            } else if (token.size() <= 16) { // keys we look for are short, longer strings never match
+                token.append(ch);
+            }
+            continue;
+        }
+
+        switch (ch) {
+            case '"':
+                if (expectValue && depth == 2 && key == "content") {
+                    inContent = true;
+                } else {
+                    inString = true;
+                    token.clear();
+                }
+                expectValue = false;
+                break;
+            case ':':
+                key = lastString;
+                expectValue = true;
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                expectValue = false;
+                break;
+            case '}':
+            case ']':
+                --depth;
+                break;
+            case ',':
+                expectValue = false;
+                break;
+            default:
+                break;
+        }
+    }
+
+    write(encoded);
+}
+
+void ContentDecoder::write(const QByteArray &encoded) {
+    if (encoded.isEmpty() || error) {
+        return;
+    }
+    store(jsonLayer.decode(encoded));
+}
+
+void ContentDecoder::store(const QByteArray &stored) {
+    if (stored.isEmpty() || error) {
+        return;
+    }
+    output(storageLayer.decode(stored));
+}
+
+void ContentDecoder::output(const QByteArray &content) {
+    if (content.isEmpty() || error) {
+        return;
+    }
+    if (sink->write(content) != content.size()) {
+        error = true;
+        return;
+    }
+    bytesWritten += content.size();
+}
+
+ResponseBody ContentDecoder::skeleton() const {
+    return cbor ? ResponseBody(cbor->skeleton(), true) : ResponseBody(json, false);
+}
+
+void ContentDecoder::useCbor() {
+    cbor = std::make_shared<CborWalker>(QByteArray(), [this](const char *data, int size, bool text) {
+        if (text) { // a server may keep the content as base64 text
+            write(QByteArray(data, size));
+        } else {
+            output(QByteArray::fromRawData(data, size));
+        }
+    }, nullptr);
+}
+
+void ListDecoder::feed(const QByteArray &chunk) {
+    if (cbor) {
+        cbor->feed(chunk.constData(), chunk.size());
+        return;
+    }
+
+    const char *data = chunk.constData();
+    const int size = chunk.size();
+
+    for (int i = 0; i < size; ++i) {
+        char ch = data[i];
+
+        if (inString) {
+            if (escaped) {
+                escaped = false;
+            } else if (ch == '\\') {
+                escaped = true;
+            } else if (ch == '"') {
+                inString = false;
+                lastString = token;
+            } else {
+                int end = i;
+                while (end < size && data[end] != '"' && data[end] != '\\') {
+                    ++end;
+                }
+                if (token.size() <= 16) { // keys we look for are short, longer strings never match
+                    token.append(data + i, qMin(end - i, 17));
+                }
+                append(data + i, end - i);
+                i = end - 1;
+                continue;
+            }
+            append(&ch, 1);
+            continue;
+        }
+
+        switch (ch) {
+            case '"':
+                append(&ch, 1);
+                inString = true;
+                token.clear();
+                expectValue = false;
+                break;
+            case ':':
+                append(&ch, 1);
+                key = lastString;
+                expectValue = true;
+                break;
+            case '{':
+            case '[':
+                if (!inArray && ch == '[' && expectValue && depth == 1 && key == arrayName) {
+                    json.append(ch);
+                    inArray = true;
+                } else {
+                    append(&ch, 1);
+                }
+                ++depth;
+                expectValue = false;
+                break;
+            case '}':
+            case ']':
+                if (inArray && depth == 2) { // end of the list
+                    json.append(ch);
+                    inArray = false;
+                    --depth;
+                    break;
+                }
+                append(&ch, 1);
+                --depth;
+                if (inArray && depth == 2 && ch == '}') { // end of an entity
+                    consumer(QJsonDocument::fromJson(element).object());
+                    element.clear();
+                }
+                break;
+            case ',':
+                append(&ch, 1);
+                expectValue = false;
+                break;
+            default:
+                append(&ch, 1);
+                break;
+        }
+    }
+}
+
+void ListDecoder::append(const char *data, int size) {
+    if (!inArray) {
+        json.append(data, size);
+    } else if (depth >= 3 || (depth == 2 && data[0] == '{')) { // values between entities are skipped
+        element.append(data, size);
+    }
+}
+
+ResponseBody ListDecoder::skeleton() const {
+    return cbor ? ResponseBody(cbor->skeleton(), true) : ResponseBody(json, false);
+}
+
+void ListDecoder::useCbor() {
+    cbor = std::make_shared<CborWalker>(arrayName, nullptr, [this](const QByteArray &element) {
+        QCborStreamReader reader(element);
+        cborConsumer(reader);
+    });
+}
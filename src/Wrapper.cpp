@@ -36,9 +36,25 @@
 #include <QtCore/QCoreApplication>
 #include <QtCore/QUrlQuery>
 #include <QtCore/QMimeDatabase>
+#include <QtCore/QBuffer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSet>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMutex>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QSaveFile>
+#include <QtCore/QSemaphore>
+#include <QtCore/QVector>
 
 #include "Wrapper.h"
 #include "models/Response.hpp"
+#include "utils/EntityCache.h"
+#include "utils/StreamDecoder.h"
+
+static QMutex userMutex; // guards the user, which is renewed in the network thread
+static QString lastLogin; // credentials given to authorize(), kept only in memory
+static QString lastPassword;
 
 // initialize static predefined entities
 Package Package::_default = Package(1, "");
@@ -52,15 +68,14 @@ User Wrapper::authorize(const QString &login, const QString &password) {
     formData.addQueryItem("login", login);
     formData.addQueryItem("password", password);
 
-    auto json = Utils::executeForm(loginUrl, formData, Utils::POST);
-    auto respJson = json.object();
+    auto body = Utils::executeForm(loginUrl, formData, Utils::POST);
 
-    auto resp = Response(respJson);
+    auto resp = body.status();
     if (!Utils::checkResponse(resp)) {
         throw Response::Exception(resp.error.code);
     }
 
-    auto userJson = respJson["user"].toObject();
+    auto userJson = body.value("user").toObject();
     if (!userJson.keys().contains("id")
         && !userJson.keys().contains("login")
         && !userJson.keys().contains("name")
@@ -68,276 +83,933 @@ User Wrapper::authorize(const QString &login, const QString &password) {
         throw Response::Exception(Response::Error::Code::MissingFields);
     }
     auto usr = User(userJson);
-    Wrapper::user = usr;
+    setUser(usr);
+    {
+        QMutexLocker locker(&userMutex);
+        lastLogin = login;
+        lastPassword = password;
+    }
     return usr;
 }
 
+User Wrapper::currentUser() {
+    QMutexLocker locker(&userMutex);
+    return user;
+}
+
+void Wrapper::setUser(const User &usr) {
+    QMutexLocker locker(&userMutex);
+    user = usr;
+    if (options.userStore.isEmpty()) {
+        return;
+    }
+
+    QJsonObject userJson;
+    userJson["id"] = usr.id;
+    userJson["login"] = usr.login;
+    userJson["name"] = usr.displayName;
+    userJson["token"] = usr.accessToken;
+    // the token gives access to the account, so only the owner may read it,
+    // the permissions are set before it is written
+    QSaveFile file(options.userStore);
+    if (file.open(QIODevice::WriteOnly) && file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner)) {
+        file.write(QJsonDocument(userJson).toJson(QJsonDocument::Compact));
+        file.commit();
+    }
+}
+
+void Wrapper::restoreUser() {
+    if (options.userStore.isEmpty()) {
+        return;
+    }
+    QFile file(options.userStore);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    auto userJson = QJsonDocument::fromJson(file.readAll()).object();
+    if (userJson["token"].toString().isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&userMutex);
+    user = User(userJson); // the token is checked by the first request, which authorizes again if it has expired
+}
+
+bool Wrapper::credentials(QString &login, QString &password) {
+    if (options.credentials) {
+        return options.credentials(login, password);
+    }
+    QMutexLocker locker(&userMutex);
+    login = lastLogin;
+    password = lastPassword;
+    return !login.isEmpty();
+}
+
 // init specified static fields
 template<> QString Wrapper::Section<File>::prefix = "file";
 template<> QString Wrapper::Section<Package>::prefix = "pkg";
 template<> QString Wrapper::Section<Repository>::prefix = "repo";
 
 template<class Entity>
-const QList<Entity *> Wrapper::Section<Entity>::getAll() {
-    auto getUrl = QUrl(
+QUrl Wrapper::Section<Entity>::sectionUrl() {
+    return QUrl(
             QString(serverAddr + "/api/user/%1/%2s/%3").arg(
-                    QString::number(user.id),
+                    QString::number(currentUser().id),
                     prefix,
-                    user.accessToken)
+                    currentUser().accessToken
+            )
     );
-    auto json = Utils::execute(getUrl, Utils::GET);
-
-    QList<Entity *> objects;
-    if (Utils::checkResponse(Response(json.object()))) {
-        auto respJson = json[prefix + "s"].toArray();
-        for (auto &&val : respJson) {
-            if (val.isObject()) {
-                auto fileJson = val.toObject();
-                objects << new Entity(fileJson);
-            }
-        }
-    }
-    return objects;
 }
 
 template<class Entity>
-const QMap<QString, Entity *> Wrapper::Section<Entity>::getAllMapped() {
-    auto getUrl = QUrl(
-            QString(serverAddr + "/api/user/%1/%2s/%3").arg(
-                    QString::number(user.id),
+QUrl Wrapper::Section<Entity>::entityUrl(int id) {
+    return QUrl(
+            QString(serverAddr + "/api/user/%1/%2/%3/%4").arg(
+                    QString::number(currentUser().id),
                     prefix,
-                    user.accessToken)
+                    QString::number(id),
+                    currentUser().accessToken
+            )
     );
-    auto json = Utils::execute(getUrl, Utils::GET);
+}
 
-    QMap<QString, Entity *> objects;
-    if (Utils::checkResponse(Response(json.object()))) {
-        auto respJson = json[prefix + "s"].toArray();
-        for (auto &&val : respJson) {
-            if (val.isObject()) {
-                auto entityJson = val.toObject();
-                auto entity = new Entity(entityJson);
-                objects.insert(entity->name, entity);
-            }
+template<class Entity>
+QString Wrapper::Section<Entity>::key(const Entity *entity) {
+    return entity->name;
+}
+
+template<>
+QString Wrapper::Section<File>::key(const File *file) {
+    return file->getRelativeName();
+}
+
+template<>
+int Wrapper::Section<File>::cacheTtl() {
+    return options.fileCacheTtl;
+}
+
+template<>
+int Wrapper::Section<Package>::cacheTtl() {
+    return options.packageCacheTtl;
+}
+
+template<>
+int Wrapper::Section<Repository>::cacheTtl() {
+    return options.repositoryCacheTtl;
+}
+
+/*!
+ * \brief Get the cache of entities got by id of the section
+ */
+template<class Entity>
+static EntityCache &entityCache() {
+    static EntityCache cache;
+    return cache;
+}
+
+template<class Entity>
+void Wrapper::Section<Entity>::invalidate(int id) {
+    entityCache<Entity>().invalidate(id);
+}
+
+template<class Entity>
+typename Wrapper::Section<Entity>::CacheStats Wrapper::Section<Entity>::cacheStats() {
+    auto stats = entityCache<Entity>().stats();
+    return CacheStats{stats.hits, stats.misses};
+}
+
+template<class Entity>
+void Wrapper::Section<Entity>::streamAll(const function<void(Entity *)> &consumer,
+                                         const function<void(const ResponseBody &)> &handler) {
+    // the entities are timed together and recorded as a single sample once the response is over
+    auto url = sectionUrl();
+    auto constructing = make_shared<qint64>(0);
+    auto decoder = make_shared<ListDecoder>((prefix + "s").toUtf8(), [consumer, constructing](const QJsonObject &entityJson) {
+        QElapsedTimer timer;
+        timer.start();
+        auto json = entityJson;
+        auto entity = new Entity(json);
+        *constructing += timer.nsecsElapsed();
+        consumer(entity);
+    }, [consumer, constructing](QCborStreamReader &reader) {
+        QElapsedTimer timer;
+        timer.start();
+        auto entity = new Entity(reader);
+        *constructing += timer.nsecsElapsed();
+        consumer(entity);
+    });
+    Utils::executeStreamed(url, decoder, [url, constructing, handler](const ResponseBody &body) {
+        Utils::recordConstruction(url, *constructing);
+        handler(body);
+    }, true);
+}
+
+template<class Entity>
+QList<Entity *> Wrapper::Section<Entity>::parseArray(const QJsonArray &array) {
+    QList<Entity *> objects;
+    for (auto &&val : array) {
+        if (val.isObject()) {
+            auto entityJson = val.toObject();
+            objects << new Entity(entityJson);
         }
     }
     return objects;
 }
 
-template<>
-const QMap<QString, File *> Wrapper::Section<File>::getAllMapped() {
-    auto getUrl = QUrl(
-            QString(serverAddr + "/api/user/%1/%2s/%3").arg(
-                    QString::number(user.id),
-                    prefix,
-                    user.accessToken)
-    );
-    auto json = Utils::execute(getUrl, Utils::GET);
-
-    QMap<QString, File *> objects;
-    if (Utils::checkResponse(Response(json.object()))) {
-        auto respJson = json[prefix + "s"].toArray();
-        for (auto &&val : respJson) {
-            if (val.isObject()) {
-                auto fileJson = val.toObject();
-                auto file = new File(fileJson);
-                objects.insert(file->getRelativeName(), file);
-            }
+template<class Entity>
+QList<Entity *> Wrapper::Section<Entity>::parseArray(QCborStreamReader &reader) {
+    QList<Entity *> objects;
+    CborReader::readArray(reader, [&objects, &reader] {
+        if (reader.isMap()) {
+            objects << new Entity(reader);
+        } else {
+            reader.next();
         }
-    }
+    });
     return objects;
 }
 
 template<class Entity>
-Entity *Wrapper::Section<Entity>::get(int id) {
-    auto getUrl = QUrl(
-            QString(serverAddr + "/api/user/%1/%2/%3/%4").arg(
-                    QString::number(user.id),
-                    prefix,
-                    QString::number(id),
-                    user.accessToken
-            )
-    );
-    auto json = Utils::execute(getUrl, Utils::GET);
-    if (!Utils::checkResponse(Response(json.object()))) {
+Entity *Wrapper::Section<Entity>::parse(const ResponseBody &body, QJsonObject &json, QByteArray &cbor) {
+    if (!body.isCbor()) {
+        if (!Utils::checkResponse(body.status())) {
+            return nullptr;
+        }
+        json = body.json()[prefix].toObject();
+        return new Entity(json);
+    }
+
+    // the entity bytes are kept for the entity cache as they are
+    Entity *entity = nullptr;
+    auto status = body.read([&body, &entity, &cbor](const QString &key, QCborStreamReader &reader) {
+        if (key != prefix || entity || !reader.isMap()) {
+            reader.next();
+            return;
+        }
+        auto begin = reader.currentOffset();
+        entity = new Entity(reader);
+        cbor = body.data().mid(static_cast<int>(begin), static_cast<int>(reader.currentOffset() - begin));
+    });
+    if (!Utils::checkResponse(status) || !entity) {
+        delete entity;
         return nullptr;
     }
-    auto respJson = json[prefix].toObject();
-    return new Entity(respJson);
+    return entity;
 }
 
-template<>
-int Wrapper::Section<File>::upload(const File *file) {
-    auto uploadUrl = QUrl(
-            QString(serverAddr + "/api/user/%1/%2s/%3").arg(
-                    QString::number(user.id),
-                    prefix,
-                    user.accessToken
-            )
-    );
-    auto json = Utils::executeForm(uploadUrl, Utils::generateMultipart(file), Utils::POST);
-    if (Utils::checkResponse(Response(json.object()))) {
-        return json.object()["created_id"].toInt();
-    } else {
-        return -1;
+template<class Entity>
+Entity *Wrapper::Section<Entity>::construct(const QJsonObject &json, const QByteArray &cbor) {
+    if (cbor.isEmpty()) {
+        auto entityJson = json;
+        return new Entity(entityJson);
     }
+    QCborStreamReader reader(cbor);
+    return new Entity(reader);
 }
 
-template<>
-int Wrapper::Section<Package>::upload(const Package *pkg) {
-    auto updateUrl = QUrl(
-            QString(serverAddr + "/api/user/%1/%2s/%3").arg(
-                    QString::number(user.id),
-                    prefix,
-                    user.accessToken
-            )
-    );
+template<class Entity>
+const QList<Entity *> Wrapper::Section<Entity>::getAll() {
+    return getAllStreamed().results();
+}
 
-    QUrlQuery formData;
-    formData.addQueryItem("id", QString::number(pkg->id));
-    formData.addQueryItem("name", pkg->name);
-    formData.addQueryItem("repo_id", QString::number(pkg->repository->id));
-
-    auto json = Utils::executeForm(updateUrl, formData, Utils::POST);
-    if (Utils::checkResponse(Response(json.object()))) {
-        return json.object()["created_id"].toInt();
-    } else {
-        return -1;
+template<class Entity>
+const QMap<QString, Entity *> Wrapper::Section<Entity>::getAllMapped() {
+    QMap<QString, Entity *> objects;
+    for (auto &&entity : getAll()) {
+        objects.insert(key(entity), entity);
     }
+    return objects;
 }
 
-template<>
-int Wrapper::Section<Repository>::upload(const Repository *repo) {
-    auto updateUrl = QUrl(
-            QString(serverAddr + "/api/user/%1/%2s/%3").arg(
-                    QString::number(user.id),
-                    prefix,
-                    user.accessToken
-            )
-    );
+template<class Entity>
+Entity *Wrapper::Section<Entity>::get(int id) {
+    return Utils::await(getAsync(id));
+}
 
-    QUrlQuery formData;
-    formData.addQueryItem("id", QString::number(repo->id));
-    formData.addQueryItem("name", repo->name);
-    formData.addQueryItem("url", repo->url);
-    formData.addQueryItem("manager", repo->manager);
-
-    auto json = Utils::executeForm(updateUrl, formData, Utils::POST);
-    if (Utils::checkResponse(Response(json.object()))) {
-        return json.object()["created_id"].toInt();
-    } else {
-        return -1;
+template<class Entity>
+int Wrapper::Section<Entity>::upload(const Entity *entity) {
+    return Utils::await(uploadAsync(entity));
+}
+
+template<class Entity>
+bool Wrapper::Section<Entity>::update(const Entity *entity) {
+    return Utils::await(updateAsync(entity));
+}
+
+template<class Entity>
+bool Wrapper::Section<Entity>::remove(int id) {
+    return Utils::await(removeAsync(id));
+}
+
+/*!
+ * \class Wrapper::Utils::Window
+ * \brief Requests a caller keeps in flight at the same time, taken back in the order they finish
+ *
+ * The futures are watched by the network thread, so the caller may be any thread but that one.
+ * All the requests added must be taken before the window is destroyed.
+ * \tparam Result Request result type
+ */
+template<class Result>
+class Wrapper::Utils::Window {
+public:
+    /*!
+     * \brief Add a started request
+     * \param key Key to take its result by, unique among the requests in flight
+     * \param future Future of the request
+     */
+    void add(int key, const QFuture<Result> &future) {
+        inFlight.insert(key, future);
+        dispatch([this, key, future] {
+            auto watcher = new QFutureWatcher<Result>;
+            QObject::connect(watcher, &QFutureWatcherBase::finished, [this, key, watcher] {
+                watcher->deleteLater();
+                QMutexLocker locker(&mutex);
+                finished << key;
+                ready.release();
+            });
+            watcher->setFuture(future);
+        });
     }
+
+    /*!
+     * \brief Block until any request in flight is finished
+     * \return Key and result of the request
+     */
+    QPair<int, Result> take() {
+        ready.acquire();
+        int key;
+        {
+            QMutexLocker locker(&mutex);
+            key = finished.takeFirst();
+        }
+        return qMakePair(key, inFlight.take(key).result());
+    }
+
+    inline int size() const {
+        return inFlight.size();
+    }
+
+    inline bool isEmpty() const {
+        return inFlight.isEmpty();
+    }
+
+private:
+    QHash<int, QFuture<Result>> inFlight;
+    QList<int> finished;
+    QMutex mutex;
+    QSemaphore ready;
+};
+
+template<class Item, class Result>
+QList<Result> Wrapper::Utils::sendAll(const QList<Item> &items, int parallel,
+                                      const function<QFuture<Result>(const Item &)> &start) {
+    QVector<Result> results(items.size());
+
+    // the next request is started as soon as any one finishes, so a slow request never holds up the others
+    Window<Result> window;
+    int next = 0;
+    while (next < items.size() || !window.isEmpty()) {
+        while (next < items.size() && window.size() < qMax(1, parallel)) {
+            window.add(next, start(items[next]));
+            ++next;
+        }
+        auto finished = window.take();
+        results[finished.first] = finished.second;
+    }
+    return results.toList();
 }
 
-template<>
-bool Wrapper::Section<File>::update(const File *file) {
-    auto uploadUrl = QUrl(
-            QString(serverAddr + "/api/user/%1/%2/%3/%4").arg(
-                    QString::number(user.id),
-                    prefix,
-                    QString::number(file->id),
-                    user.accessToken
-            )
-    );
-    auto json = Utils::executeForm(uploadUrl, Utils::generateMultipart(file), Utils::PUT);
-    return Utils::checkResponse(Response(json.object()));
+template<class Entity>
+QList<int> Wrapper::Section<Entity>::uploadMany(const QList<Entity *> &entities, int parallel) {
+    return Utils::sendAll<Entity *, int>(entities, parallel, [](Entity *const &entity) {
+        return uploadAsync(entity);
+    });
 }
 
-template<>
-bool Wrapper::Section<Package>::update(const Package *pkg) {
-    auto updateUrl = QUrl(
-            QString(serverAddr + "/api/user/%1/%2/%3/%4").arg(
-                    QString::number(user.id),
-                    prefix,
-                    QString::number(pkg->id),
-                    user.accessToken
-            )
-    );
+template<class Entity>
+QList<bool> Wrapper::Section<Entity>::updateMany(const QList<Entity *> &entities, int parallel) {
+    return Utils::sendAll<Entity *, bool>(entities, parallel, [](Entity *const &entity) {
+        return updateAsync(entity);
+    });
+}
 
-    QUrlQuery formData;
-    formData.addQueryItem("name", pkg->name);
-    formData.addQueryItem("repo_id", QString::number(pkg->repository->id));
+template<class Entity>
+QList<bool> Wrapper::Section<Entity>::removeMany(const QList<int> &ids, int parallel) {
+    return Utils::sendAll<int, bool>(ids, parallel, [](const int &id) {
+        return removeAsync(id);
+    });
+}
 
-    auto json = Utils::executeForm(updateUrl, formData, Utils::PUT);
-    return Utils::checkResponse(Response(json.object()));
+template<class Entity>
+QFuture<QList<Entity *>> Wrapper::Section<Entity>::getAllAsync() {
+    auto entities = make_shared<QList<Entity *>>();
+
+    QFutureInterface<QList<Entity *>> promise;
+    promise.reportStarted();
+    streamAll([entities](Entity *entity) {
+        *entities << entity;
+    }, [promise, entities](const ResponseBody &body) {
+        Utils::checkResponse(body.status());
+        Utils::resolve(promise, *entities);
+    });
+    return promise.future();
 }
 
-template<>
-bool Wrapper::Section<Repository>::update(const Repository *repo) {
-    auto updateUrl = QUrl(
-            QString(serverAddr + "/api/user/%1/%2/%3/%4").arg(
-                    QString::number(user.id),
+template<class Entity>
+QFuture<Entity *> Wrapper::Section<Entity>::getAllStreamed() {
+    QFutureInterface<Entity *> promise;
+    promise.reportStarted();
+    streamAll([promise](Entity *entity) mutable {
+        promise.reportResult(entity);
+    }, [promise](const ResponseBody &body) mutable {
+        Utils::checkResponse(body.status());
+        promise.reportFinished();
+    });
+    return promise.future();
+}
+
+template<class Entity>
+QFuture<Entity *> Wrapper::Section<Entity>::getAsync(int id) {
+    QFutureInterface<Entity *> promise;
+    promise.reportStarted();
+
+    auto &cache = entityCache<Entity>();
+    QJsonObject cachedJson;
+    QByteArray cachedCbor;
+    if (cacheTtl() > 0 && cache.lookup(id, cachedJson, cachedCbor)) {
+        Utils::resolve(promise, construct(cachedJson, cachedCbor));
+        return promise.future();
+    }
+
+    auto version = cache.version();
+    auto url = entityUrl(id);
+    Utils::executeAsync(url, Utils::GET, [promise, id, version, url](const ResponseBody &body) {
+        QElapsedTimer timer;
+        timer.start();
+        QJsonObject json;
+        QByteArray cbor;
+        auto entity = parse(body, json, cbor);
+        Utils::recordConstruction(url, timer.nsecsElapsed());
+        if (entity) {
+            entityCache<Entity>().store(id, json, cbor, cacheTtl(), version);
+        }
+        Utils::resolve(promise, entity);
+    });
+    return promise.future();
+}
+
+template<class Entity>
+QFuture<int> Wrapper::Section<Entity>::uploadAsync(const Entity *entity) {
+    QFutureInterface<int> promise;
+    promise.reportStarted();
+    Utils::submitAsync(sectionUrl(), entity, Utils::POST, [promise](const ResponseBody &body) {
+        if (Utils::checkResponse(body.status())) {
+            Utils::resolve(promise, body.value("created_id").toInt());
+        } else {
+            Utils::resolve(promise, -1);
+        }
+    });
+    return promise.future();
+}
+
+template<class Entity>
+QFuture<bool> Wrapper::Section<Entity>::updateAsync(const Entity *entity) {
+    auto id = entity->id;
+    invalidate(id);
+
+    QFutureInterface<bool> promise;
+    promise.reportStarted();
+    Utils::submitAsync(entityUrl(id), entity, Utils::PUT, [promise, id](const ResponseBody &body) {
+        invalidate(id); // gets started while the request was in flight must not be cached
+        Utils::resolve(promise, Utils::checkResponse(body.status()));
+    });
+    return promise.future();
+}
+
+template<class Entity>
+QFuture<bool> Wrapper::Section<Entity>::removeAsync(int id) {
+    invalidate(id);
+
+    QFutureInterface<bool> promise;
+    promise.reportStarted();
+    Utils::executeAsync(entityUrl(id), Utils::DELETE, [promise, id](const ResponseBody &body) {
+        invalidate(id); // gets started while the request was in flight must not be cached
+        Utils::resolve(promise, Utils::checkResponse(body.status()));
+    });
+    return promise.future();
+}
+
+template<class Entity>
+typename Wrapper::Section<Entity>::Changes Wrapper::Section<Entity>::getChangesSince(const QString &cursor) {
+    return Utils::await(getChangesSinceAsync(cursor));
+}
+
+template<class Entity>
+QFuture<typename Wrapper::Section<Entity>::Changes>
+Wrapper::Section<Entity>::getChangesSinceAsync(const QString &cursor) {
+    auto changesUrl = QUrl(
+            QString(serverAddr + "/api/user/%1/%2s/changes/%3/%4").arg(
+                    QString::number(currentUser().id),
                     prefix,
-                    QString::number(repo->id),
-                    user.accessToken
+                    cursor.isEmpty() ? "0" : QString::fromUtf8(QUrl::toPercentEncoding(cursor)),
+                    currentUser().accessToken
             )
     );
 
-    QUrlQuery formData;
-    formData.addQueryItem("name", repo->name);
-    formData.addQueryItem("url", repo->url);
-    formData.addQueryItem("manager", repo->manager);
-
-    auto json = Utils::executeForm(updateUrl, formData, Utils::PUT);
-    return Utils::checkResponse(Response(json.object()));
+    QFutureInterface<Changes> promise;
+    promise.reportStarted();
+    Utils::executeAsync(changesUrl, Utils::GET, [promise, cursor, changesUrl](const ResponseBody &body) {
+        Changes changes;
+        changes.cursor = cursor;
+        if (body.isCbor()) {
+            QElapsedTimer timer;
+            timer.start();
+            Changes read;
+            auto status = body.read([&read](const QString &key, QCborStreamReader &reader) {
+                if (key != "changes") {
+                    reader.next();
+                    return;
+                }
+                CborReader::readMap(reader, [&read, &reader](const QString &name) {
+                    if (name == "created") {
+                        read.created = parseArray(reader);
+                    } else if (name == "updated") {
+                        read.updated = parseArray(reader);
+                    } else if (name == "deleted") {
+                        read.deleted = parseArray(reader);
+                    } else if (name == "cursor") {
+                        read.cursor = CborReader::readString(reader);
+                    } else {
+                        reader.next();
+                    }
+                });
+            });
+            Utils::recordConstruction(changesUrl, timer.nsecsElapsed());
+            if (Utils::checkResponse(status)) {
+                changes = read;
+                changes.ok = true;
+            } else {
+                for (auto &&list : {read.created, read.updated, read.deleted}) {
+                    qDeleteAll(list);
+                }
+            }
+        } else if (Utils::checkResponse(body.status())) {
+            QElapsedTimer timer;
+            timer.start();
+            auto changesJson = body.json()["changes"].toObject();
+            changes.created = parseArray(changesJson["created"].toArray());
+            changes.updated = parseArray(changesJson["updated"].toArray());
+            changes.deleted = parseArray(changesJson["deleted"].toArray());
+            Utils::recordConstruction(changesUrl, timer.nsecsElapsed());
+            changes.cursor = changesJson["cursor"].toString();
+            changes.ok = true;
+        }
+        if (changes.ok) {
+            for (auto &&list : {changes.updated, changes.deleted}) {
+                for (auto &&entity : list) {
+                    invalidate(entity->id);
+                }
+            }
+        }
+        Utils::resolve(promise, changes);
+    });
+    return promise.future();
 }
 
 template<class Entity>
-bool Wrapper::Section<Entity>::remove(int id) {
-    auto deleteFileUrl = QUrl(
-            QString(serverAddr + "/api/user/%1/%2/%3/%4").arg(
-                    QString::number(user.id),
-                    prefix,
+void Wrapper::Section<Entity>::merge(QMap<QString, Entity *> &entities, const Changes &changes) {
+    for (auto &&entity : changes.deleted) {
+        delete entities.take(key(entity));
+        delete entity;
+    }
+    for (auto &&list : {changes.created, changes.updated}) {
+        for (auto &&entity : list) {
+            auto &stored = entities[key(entity)];
+            if (stored != entity) {
+                delete stored;
+            }
+            stored = entity;
+        }
+    }
+}
+
+QUrl Wrapper::Files::contentUrl(int id) {
+    return QUrl(
+            QString(serverAddr + "/api/user/%1/file/%2/content/%3").arg(
+                    QString::number(currentUser().id),
                     QString::number(id),
-                    user.accessToken
+                    currentUser().accessToken
             )
     );
-    auto json = Utils::execute(deleteFileUrl, Utils::DELETE);
-    return Utils::checkResponse(Response(json.object()));
 }
 
 QByteArray Wrapper::Files::getContent(int id) {
-    auto getContentUrl = QUrl(
-            QString(serverAddr + "/api/user/%1/file/%2/content/%3").arg(
-                    QString::number(user.id),
-                    QString::number(id),
-                    user.accessToken
+    return Utils::await(getContentAsync(id));
+}
+
+qint64 Wrapper::Files::getContent(int id, QIODevice *sink) {
+    return Utils::await(getContentAsync(id, sink));
+}
+
+QFuture<QByteArray> Wrapper::Files::getContentAsync(int id) {
+    auto buffer = make_shared<QBuffer>();
+    buffer->open(QIODevice::WriteOnly);
+    auto decoder = make_shared<ContentDecoder>(buffer.get());
+
+    QFutureInterface<QByteArray> promise;
+    promise.reportStarted();
+    Utils::executeStreamed(contentUrl(id), decoder, [promise, buffer](const ResponseBody &body) {
+        if (!Utils::checkResponse(body.status())) {
+            Utils::resolve(promise, QByteArray());
+            return;
+        }
+        Utils::resolve(promise, buffer->data());
+    });
+    return promise.future();
+}
+
+QFuture<qint64> Wrapper::Files::getContentAsync(int id, QIODevice *sink) {
+    auto decoder = make_shared<ContentDecoder>(sink);
+
+    QFutureInterface<qint64> promise;
+    promise.reportStarted();
+    Utils::executeStreamed(contentUrl(id), decoder, [promise, decoder](const ResponseBody &body) {
+        if (!Utils::checkResponse(body.status()) || decoder->failed()) {
+            Utils::resolve(promise, qint64(-1));
+            return;
+        }
+        Utils::resolve(promise, decoder->written());
+    });
+    return promise.future();
+}
+
+Wrapper::Files::ContentsReport Wrapper::Files::getContents(const QList<int> &ids,
+                                                            const function<QIODevice *(int)> &sinkFactory,
+                                                            int parallel) {
+    ContentsReport report;
+    report.written.reserve(ids.size());
+    QElapsedTimer timer;
+    timer.start();
+
+    // the next download is started as soon as any one finishes, so a large content never holds up the others
+    QVector<QIODevice *> sinks(ids.size());
+    QVector<qint64> written(ids.size());
+    Utils::Window<qint64> window;
+    int next = 0;
+    while (next < ids.size() || !window.isEmpty()) {
+        while (next < ids.size() && window.size() < qMax(1, parallel)) {
+            auto sink = sinkFactory(ids[next]);
+            sinks[next] = sink;
+            if (!sink) {
+                QFutureInterface<qint64> skipped;
+                skipped.reportStarted();
+                Utils::resolve(skipped, qint64(-1));
+                window.add(next, skipped.future());
+            } else {
+                window.add(next, getContentAsync(ids[next], sink));
+            }
+            ++next;
+        }
+
+        auto download = window.take();
+        written[download.first] = download.second;
+        auto sink = sinks[download.first];
+        if (!sink) {
+            ++report.skipped;
+            continue;
+        }
+        sink->close();
+        delete sink;
+        if (download.second == -1) {
+            ++report.failed;
+        } else {
+            report.bytes += download.second;
+        }
+    }
+    report.written = written.toList();
+
+    report.elapsed = timer.elapsed();
+    return report;
+}
+
+Wrapper::Files::SyncReport Wrapper::Files::sync(const QList<File *> &files, int parallel) {
+    SyncReport report;
+    auto remote = getAllMapped();
+
+    QHash<QByteArray, int> stored; // checksum -> id of a server file with such content
+    for (auto &&remoteFile : remote) {
+        if (!remoteFile->checksum.isEmpty()) {
+            stored.insert(remoteFile->checksum, remoteFile->id);
+        }
+    }
+
+    QSet<File *> updates;
+    QList<File *> carriers; // the first file of every content unknown to the server
+    QList<File *> copies;
+    QSet<QByteArray> carried;
+    for (auto &&file : files) {
+        auto existing = remote.value(file->getRelativeName());
+        if (existing) {
+            file->id = existing->id;
+            if (!file->checksum.isEmpty() && existing->checksum == file->checksum) {
+                ++report.skipped;
+                continue;
+            }
+            updates << file;
+        }
+
+        if (file->checksum.isEmpty()) {
+            carriers << file;
+        } else if (stored.contains(file->checksum) || carried.contains(file->checksum)) {
+            copies << file;
+        } else {
+            carried << file->checksum;
+            carriers << file;
+        }
+    }
+    qDeleteAll(remote);
+
+    auto send = [&](const QList<File *> &batch) {
+        QHash<File *, int> sources;
+        auto ids = Utils::sendAll<File *, int>(batch, parallel, [&stored, &updates, &sources](File *const &file) {
+            auto sourceId = stored.value(file->checksum, -1);
+            sources.insert(file, sourceId);
+            return sendAsync(file, updates.contains(file), sourceId);
+        });
+        for (int i = 0; i < batch.size(); ++i) {
+            auto file = batch[i];
+            if (ids[i] == -1) {
+                ++report.failed;
+                continue;
+            }
+            if (sources[file] != -1) {
+                ++report.reused;
+            } else {
+                report.bytesSent += file->content.isEmpty()
+                                    ? QFileInfo(file->getAbsoluteName()).size()
+                                    : file->content.size();
+            }
+            file->id = ids[i];
+            if (updates.contains(file)) {
+                ++report.updated;
+            } else {
+                ++report.uploaded;
+            }
+            if (!file->checksum.isEmpty()) {
+                stored.insert(file->checksum, ids[i]);
+            }
+        }
+    };
+    send(carriers);
+    send(copies); // copies of failed carriers have no stored content and are sent in full
+
+    return report;
+}
+
+QFuture<int> Wrapper::Files::sendAsync(const File *file, bool update, int sourceId) {
+    auto id = file->id;
+    if (update) {
+        invalidate(id);
+    }
+
+    QFutureInterface<int> promise;
+    promise.reportStarted();
+    Utils::executeUploadAsync(
+            update ? entityUrl(id) : sectionUrl(),
+            file,
+            sourceId,
+            update ? Utils::PUT : Utils::POST,
+            [promise, update, id](const ResponseBody &body) {
+                if (update) {
+                    invalidate(id);
+                }
+                if (!Utils::checkResponse(body.status())) {
+                    Utils::resolve(promise, -1);
+                } else {
+                    Utils::resolve(promise, update ? id : body.value("created_id").toInt());
+                }
+            }
+    );
+    return promise.future();
+}
+
+QUrl Wrapper::Files::uploadUrl(const QString &uploadId, const QString &action) {
+    auto path = action.isEmpty() ? uploadId : uploadId + "/" + action;
+    return QUrl(
+            QString(serverAddr + "/api/user/%1/file/upload/%2/%3").arg(
+                    QString::number(currentUser().id),
+                    path,
+                    currentUser().accessToken
             )
     );
-    auto json = Utils::execute(getContentUrl, Utils::GET);
-    if (!Utils::checkResponse(Response(json.object()))) {
-        return nullptr;
+}
+
+int Wrapper::Files::uploadChunked(const File *file, ChunkedUpload &upload) {
+    return sendChunked(file, upload, -1);
+}
+
+bool Wrapper::Files::updateChunked(const File *file, ChunkedUpload &upload) {
+    return sendChunked(file, upload, file->id) != -1;
+}
+
+int Wrapper::Files::sendChunked(const File *file, ChunkedUpload &upload, int fileId) {
+    QBuffer memorySource;
+    QFile diskSource(file->getAbsoluteName());
+    QIODevice *source = &diskSource;
+    if (!file->content.isEmpty()) {
+        memorySource.setData(file->content);
+        source = &memorySource;
+    }
+    if (!source->open(QIODevice::ReadOnly) || upload.chunkSize <= 0) {
+        return -1;
+    }
+    auto chunks = static_cast<int>(qMax<qint64>(1, (source->size() + upload.chunkSize - 1) / upload.chunkSize));
+
+    QSet<int> received;
+    if (!upload.id.isEmpty()) {
+        auto body = Utils::execute(uploadUrl(upload.id), Utils::GET);
+        if (Utils::checkResponse(body.status())) {
+            for (auto &&index : body.value("upload").toObject()["received"].toArray()) {
+                received << index.toInt();
+            }
+        } else {
+            upload.id.clear(); // the session has expired, start over
+        }
+    }
+    if (upload.id.isEmpty()) {
+        auto startUrl = QUrl(
+                QString(serverAddr + "/api/user/%1/file/uploads/%2").arg(
+                        QString::number(currentUser().id),
+                        currentUser().accessToken
+                )
+        );
+
+        QUrlQuery formData;
+        if (fileId != -1) {
+            formData.addQueryItem("file_id", QString::number(fileId));
+        }
+        formData.addQueryItem("name", file->name);
+        formData.addQueryItem("path", file->path);
+        formData.addQueryItem("checksum", QString::fromUtf8(file->checksum));
+        formData.addQueryItem("created", QString::number(file->created.toSecsSinceEpoch()));
+        formData.addQueryItem("modified", QString::number(file->modified.toSecsSinceEpoch()));
+        formData.addQueryItem("package_id", QString::number(file->package->id));
+        formData.addQueryItem("size", QString::number(source->size()));
+        formData.addQueryItem("chunk_size", QString::number(upload.chunkSize));
+
+        auto body = Utils::executeForm(startUrl, formData, Utils::POST);
+        if (!Utils::checkResponse(body.status())) {
+            return -1;
+        }
+        upload.id = body.value("upload").toObject()["id"].toString();
+    }
+
+    QList<int> pending;
+    for (int index = 0; index < chunks; ++index) {
+        if (!received.contains(index)) {
+            pending << index;
+        }
+    }
+
+    // keep a window of parts in flight refilled whenever any part finishes,
+    // failed parts go back to the queue until they run out of attempts
+    QHash<int, int> failures;
+    Utils::Window<bool> window;
+    bool failed = false;
+    while (!window.isEmpty() || (!pending.isEmpty() && !failed)) {
+        while (!failed && !pending.isEmpty() && window.size() < qMax(1, upload.parallel)) {
+            auto index = pending.takeFirst();
+            source->seek(index * upload.chunkSize);
+            window.add(index, uploadChunkAsync(upload.id, index, source->read(upload.chunkSize)));
+        }
+
+        auto sent = window.take();
+        if (!sent.second) {
+            if (++failures[sent.first] < upload.attempts) {
+                pending << sent.first;
+            } else {
+                failed = true; // let the parts in flight finish, so the server acknowledges them
+            }
+        }
+    }
+    if (failed) {
+        return -1;
     }
-    auto respJson = json[prefix].toObject();
 
-    File file(respJson);
-    auto content = move(file.content);
+    QUrlQuery completeForm;
+    auto body = Utils::executeForm(uploadUrl(upload.id, "complete"), completeForm, Utils::POST);
+    if (!Utils::checkResponse(body.status())) {
+        return -1;
+    }
+    upload.id.clear();
+    if (fileId != -1) {
+        invalidate(fileId);
+    }
+    return body.value("created_id").toInt();
+}
 
-    return QByteArray::fromBase64(content);
+QFuture<bool> Wrapper::Files::uploadChunkAsync(const QString &uploadId, int index, const QByteArray &chunk) {
+    QFutureInterface<bool> promise;
+    promise.reportStarted();
+    Utils::executeFormAsync(
+            uploadUrl(uploadId, "chunk/" + QString::number(index)),
+            [index, chunk] {
+                return Utils::generateChunkMultipart(index, chunk);
+            },
+            Utils::PUT,
+            [promise](const ResponseBody &body) {
+                Utils::resolve(promise, Utils::checkResponse(body.status()));
+            }
+    );
+    return promise.future();
 }
 
 QList<File *> Wrapper::Packages::getConfigs(int id) {
+    return Utils::await(getConfigsAsync(id));
+}
+
+QFuture<QList<File *>> Wrapper::Packages::getConfigsAsync(int id) {
     auto getConfigsUrl = QUrl(
             QString(serverAddr + "/api/user/%1/pkg/%2/configs/%3").arg(
-                    QString::number(user.id),
+                    QString::number(currentUser().id),
                     QString::number(id),
-                    user.accessToken
+                    currentUser().accessToken
             )
     );
-    auto json = Utils::execute(getConfigsUrl, Utils::GET);
-
-    QList<File *> configs;
-    if (Utils::checkResponse(Response(json.object()))) {
-        auto respJson = json["files"].toArray();
-        for (auto &&val : respJson) {
-            if (val.isObject()) {
-                auto fileJson = val.toObject();
-                configs << new File(fileJson);
+
+    QFutureInterface<QList<File *>> promise;
+    promise.reportStarted();
+    Utils::executeAsync(getConfigsUrl, Utils::GET, [promise](const ResponseBody &body) {
+        QList<File *> configs;
+        if (body.isCbor()) {
+            auto status = body.read([&configs](const QString &key, QCborStreamReader &reader) {
+                if (key != "files") {
+                    reader.next();
+                    return;
+                }
+                CborReader::readArray(reader, [&configs, &reader] {
+                    if (reader.isMap()) {
+                        configs << new File(reader);
+                    } else {
+                        reader.next();
+                    }
+                });
+            });
+            if (!Utils::checkResponse(status)) {
+                qDeleteAll(configs);
+                configs.clear();
+            }
+        } else if (Utils::checkResponse(body.status())) {
+            auto respJson = body.json()["files"].toArray();
+            for (auto &&val : respJson) {
+                if (val.isObject()) {
+                    auto fileJson = val.toObject();
+                    configs << new File(fileJson);
+                }
             }
         }
-    }
-    return configs;
+        Utils::resolve(promise, configs);
+    });
+    return promise.future();
 }
 
 // tell the compiler to "implement" methods from super class
@@ -0,0 +1,72 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Internal access to the request builders for the tests and benchmarks
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_WRAPPERTESTING_H
+#define ANTARCTICA_WRAPPERTESTING_H
+
+
+#include "api/Wrapper.h"
+
+/*!
+ * \class Wrapper::Testing
+ * \brief Request builders and session state opened for the tests and benchmarks, not installed with the library
+ */
+class Wrapper::Testing {
+public:
+    /*!
+     * \class Wrapper::Testing::Files
+     * \brief Files section with its URL builders opened
+     */
+    class Files : public Wrapper::Files {
+    public:
+        using Wrapper::Files::sectionUrl;
+        using Wrapper::Files::entityUrl;
+        using Wrapper::Files::contentUrl;
+        using Wrapper::Files::key;
+    };
+
+    /*!
+     * \brief Set a signed in user without authorizing, so URLs are built like in a real session
+     * \param usr User to set
+     */
+    static void signIn(const User &usr) {
+        Wrapper::setUser(usr);
+    }
+
+    /*!
+     * \brief Build the upload form of a file the way uploads do
+     * \param file File to upload
+     * \return Multipart form data owned by the caller, or nullptr if the file can't be read
+     */
+    static QHttpMultiPart *generateMultipart(const File *file) {
+        return Utils::generateMultipart(file);
+    }
+};
+
+
+#endif //ANTARCTICA_WRAPPERTESTING_H
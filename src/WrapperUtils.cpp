@@ -27,105 +27,1063 @@
  */
 
 
+#include <atomic>
+#include <mutex>
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkRequest>
 #include <QtNetwork/QNetworkReply>
 #include <QtCore/QJsonDocument>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QBuffer>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFutureInterface>
+#include <QtCore/QHash>
+#include <QtCore/QSemaphore>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QRandomGenerator>
+#include <QtCore/QSaveFile>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
 #include <QtCore/QUrlQuery>
+#include <QtCore/QUuid>
 
 #include "api/Wrapper.h"
+#include "api/utils/GzipEncoder.h"
+#include "api/utils/Metrics.h"
+#include "api/utils/ResponseCache.h"
+#include "api/utils/StreamDecoder.h"
 
-QJsonDocument Wrapper::Utils::execute(const QUrl &requestUrl, RequestType type) {
-    qDebug() << "Executing " + requestUrl.toString();
+static const qint64 streamBufferSize = 1 << 20; // bytes of a streamed response held by the reply at most
+// larger streamed responses are cached from a file, so a listing never has to be held whole in memory
+static const int maxBufferedStreamSize = 4 << 20;
+static const qint64 minCompressedSize = 512; // smaller contents don't pay off the gzip header and the CPU time
+static const int compressionChunkSize = 64 * 1024;
+
+static ResponseCache responseCache;
+static Metrics requestMetrics;
+static std::atomic<quint64> requestsCount{0};
+static std::atomic<quint64> handshakesCount{0};
+static std::atomic<quint64> multiplexedCount{0};
+static std::atomic<quint64> coalescedCount{0};
+static std::atomic<quint64> contentBytes{0};
+static std::atomic<quint64> sentContentBytes{0};
+static std::atomic<quint64> compressionTime{0};
+static std::atomic<bool> gzipAccepted{false}; // whether the server has said it takes gzip request bodies
+
+static QString sessionFile; // used only in the network thread
+static QByteArray savedTicket;
+
+/*!
+ * \brief Save the TLS session ticket of a finished reply if it is a new one
+ */
+static void saveSessionTicket(const QNetworkReply *reply) {
+    if (sessionFile.isEmpty() || !reply->url().scheme().startsWith("https")) {
+        return;
+    }
+    auto ticket = reply->sslConfiguration().sessionTicket();
+    if (ticket.isEmpty() || ticket == savedTicket) {
+        return;
+    }
+
+    // the ticket resumes the session without any other secret, so only the owner may read it;
+    // the permissions are set before it is written, so it's never readable by others even for a moment
+    QSaveFile file(sessionFile);
+    if (file.open(QIODevice::WriteOnly) && file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner)
+        && file.write(ticket) == ticket.size() && file.commit()) {
+        savedTicket = ticket;
+    }
+}
+
+/*!
+ * \class NetworkThread
+ * \brief Thread running its own event loop which owns the access manager and all the replies
+ *
+ * The access manager keeps its connections alive and reuses them for every following request
+ * to the same host, so the TCP and TLS handshakes are paid only once.
+ */
+class NetworkThread : public QThread {
+public:
+    QNetworkAccessManager *manager = nullptr;
+    QSemaphore ready;
 
-    auto manager = new QNetworkAccessManager;
+protected:
+    void run() override {
+        QNetworkAccessManager accessManager;
+        // emitted only when a new connection finishes its TLS handshake, reused connections are silent
+        QObject::connect(&accessManager, &QNetworkAccessManager::encrypted, [](QNetworkReply *) {
+            ++handshakesCount;
+        });
+        // TLS 1.3 tickets come after the handshake, so they are looked for when the reply is over
+        QObject::connect(&accessManager, &QNetworkAccessManager::finished, saveSessionTicket);
+        manager = &accessManager;
+        ready.release();
+
+        exec();
+        manager = nullptr; // unfinished replies are destroyed together with the manager
+    }
+};
+
+/*!
+ * \class CircuitBreaker
+ * \brief Counter of transient failures in a row which stops sending requests to a server that is clearly down
+ *
+ * Used only in the network thread. Once the circuit is open, requests fail at once; after the cooldown
+ * a single request is let through to probe the server and its success closes the circuit again.
+ */
+class CircuitBreaker {
+public:
+    bool allows(int cooldown) {
+        if (!openedAt.isValid()) {
+            return true;
+        }
+        if (openedAt.elapsed() < cooldown) {
+            return false;
+        }
+        openedAt.start(); // the others wait for the probe or for the next cooldown
+        return true;
+    }
+
+    void record(bool ok, int threshold) {
+        if (ok) {
+            failures = 0;
+            openedAt.invalidate();
+        } else if (threshold > 0 && ++failures >= threshold) {
+            openedAt.start();
+        }
+    }
+
+private:
+    int failures = 0;
+    QElapsedTimer openedAt;
+};
+
+static CircuitBreaker circuitBreaker;
+
+/*!
+ * \class SharedStream
+ * \brief Decoder passing one streamed response to the decoders of all the identical requests
+ *
+ * A request may join the stream only until its first chunk arrives, later ones would miss the beginning.
+ */
+class SharedStream : public StreamDecoder {
+public:
+    using Handler = function<void(const ResponseBody &)>;
+
+    void join(const shared_ptr<StreamDecoder> &decoder, const Handler &handler) {
+        consumers << qMakePair(decoder, handler);
+    }
+
+    bool started() const {
+        return fed;
+    }
+
+    void feed(const QByteArray &chunk) override {
+        fed = true;
+        for (auto &&consumer : consumers) {
+            consumer.first->feed(chunk);
+        }
+    }
+
+    ResponseBody skeleton() const override {
+        return consumers.isEmpty() ? ResponseBody() : consumers.first().first->skeleton();
+    }
+
+    void reset() override {
+        fed = false;
+        for (auto &&consumer : consumers) {
+            consumer.first->reset();
+        }
+    }
+
+    void useCbor() override {
+        for (auto &&consumer : consumers) {
+            consumer.first->useCbor();
+        }
+    }
+
+    /*!
+     * \brief Pass every decoder's skeleton to its handler
+     */
+    void finish() const {
+        for (auto &&consumer : consumers) {
+            consumer.second(consumer.first->skeleton());
+        }
+    }
+
+private:
+    QList<QPair<shared_ptr<StreamDecoder>, Handler>> consumers;
+    bool fed = false;
+};
+
+// GET requests in flight by their URLs, identical ones wait for the same response; used only in the network thread
+static QHash<QUrl, shared_ptr<QList<function<void(const ResponseBody &)>>>> pendingGets;
+static QHash<QUrl, shared_ptr<SharedStream>> pendingStreams;
+
+/*!
+ * \brief Stop joining the reads in flight once a write is sent
+ * They may be answered with the data from before the write, so the later reads go on their own.
+ * A write to an entity also changes the listings and the contents showing it, so all the reads are detached,
+ * the ones in flight still answer their callers.
+ */
+static void detachReads() {
+    pendingGets.clear();
+    pendingStreams.clear();
+}
+static QList<function<void(bool)>> reauthorizing; // callbacks waiting for the login request in flight
+
+static NetworkThread *networkThread = nullptr;
+static std::once_flag networkThreadStarted;
+
+static void stopNetworkThread() {
+    networkThread->quit();
+    networkThread->wait();
+    delete networkThread;
+    networkThread = nullptr;
+}
+
+Wrapper::ConnectionStats Wrapper::connectionStats() {
+    return ConnectionStats{requestsCount.load(), handshakesCount.load(), multiplexedCount.load(),
+                           coalescedCount.load()};
+}
+
+Wrapper::CompressionStats Wrapper::compressionStats() {
+    return CompressionStats{contentBytes.load(), sentContentBytes.load(), compressionTime.load()};
+}
 
+Metrics::Snapshot Wrapper::metrics() {
+    return requestMetrics.snapshot();
+}
+
+QString Wrapper::Utils::endpoint(const QUrl &requestUrl, const QString &method) {
+    return Metrics::endpoint(method, requestUrl.path(), currentUser().accessToken);
+}
+
+void Wrapper::Utils::recordConstruction(const QUrl &requestUrl, qint64 nsecs) {
+    requestMetrics.record(endpoint(requestUrl, "GET"), Metrics::Construction, nsecs);
+}
+
+QThread *Wrapper::Utils::executor() {
+    std::call_once(networkThreadStarted, [] {
+        networkThread = new NetworkThread;
+        networkThread->setObjectName("IcebreakerNetwork");
+        networkThread->start();
+        networkThread->ready.acquire();
+        if (QCoreApplication::instance()) {
+            qAddPostRoutine(stopNetworkThread);
+        }
+    });
+    return networkThread;
+}
+
+QNetworkAccessManager *Wrapper::Utils::manager() {
+    ++requestsCount;
+    return networkThread->manager;
+}
+
+void Wrapper::Utils::dispatch(const function<void()> &task) {
+    auto thread = executor();
+    if (QThread::currentThread() == thread) {
+        task();
+    } else {
+        QMetaObject::invokeMethod(networkThread->manager, task, Qt::QueuedConnection);
+    }
+}
+
+QNetworkRequest Wrapper::Utils::createRequest(const QUrl &requestUrl) {
     QNetworkRequest request(requestUrl);
     request.setSslConfiguration(sslConfiguration);
-    QNetworkReply *reply;
-    switch (type) {
-        case GET:
-            reply = manager->get(request);
-            break;
-        case DELETE:
-            reply = manager->deleteResource(request);
-            break;
+    // negotiated with ALPN during the TLS handshake, servers without HTTP/2 keep talking HTTP/1.1;
+    // there's nothing to negotiate with over cleartext, so HTTP/2 is spoken there only if asked for explicitly
+    // "Accept-Encoding: gzip, deflate" is added by the access manager, which also decodes the responses
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, options.http2);
+    if (options.http2Cleartext && requestUrl.scheme() == "http") {
+        request.setAttribute(QNetworkRequest::Http2DirectAttribute, true);
+    }
+    if (options.cbor) {
+        request.setRawHeader("Accept", "application/cbor, application/json;q=0.9");
+    }
+    return request;
+}
+
+void Wrapper::Utils::configure() {
+    responseCache.setDirectory(options.cacheDirectory);
+
+    if (!options.sessionFile.isEmpty()) {
+        // the ticket lets the next launch resume the TLS session instead of a full handshake
+        sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+        QFile saved(options.sessionFile);
+        if (saved.open(QIODevice::ReadOnly)) {
+            sslConfiguration.setSessionTicket(saved.readAll());
+        }
+    }
+
+    if (options.sessionFile.isEmpty() && !options.prewarm) {
+        return;
+    }
+    auto server = QUrl(serverAddr);
+    auto config = sslConfiguration;
+    if (options.http2) {
+        config.setAllowedNextProtocols({QSslConfiguration::ALPNProtocolHTTP2, QSslConfiguration::NextProtocolHttp1_1});
+    }
+    dispatch([server, config, file = options.sessionFile, prewarm = options.prewarm] {
+        sessionFile = file;
+        if (!prewarm) {
+            return;
+        }
+        // the connection is kept alive by the access manager and taken by the first request to the server
+        if (server.scheme() == "https") {
+            networkThread->manager->connectToHostEncrypted(server.host(), static_cast<quint16>(server.port(443)), config);
+        } else {
+            networkThread->manager->connectToHost(server.host(), static_cast<quint16>(server.port(80)));
+        }
+    });
+}
+
+static void addValidators(QNetworkRequest &request) {
+    ResponseCache::Entry cached;
+    if (responseCache.lookup(request.url(), cached)) { // let the server answer "not modified"
+        if (!cached.etag.isEmpty()) {
+            request.setRawHeader("If-None-Match", cached.etag);
+        }
+        if (!cached.lastModified.isEmpty()) {
+            request.setRawHeader("If-Modified-Since", cached.lastModified);
+        }
+    }
+}
+
+static bool hasValidators(const QNetworkReply *reply) {
+    return reply->operation() == QNetworkAccessManager::GetOperation
+           && reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 200
+           && (reply->hasRawHeader("ETag") || reply->hasRawHeader("Last-Modified"));
+}
+
+static bool isNotModified(const QNetworkReply *reply, ResponseCache::Entry &cached) {
+    return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304
+           && responseCache.lookup(reply->request().url(), cached);
+}
+
+// the entry the validators came from may be evicted while the request is in flight,
+// then "304 Not Modified" carries nothing to answer with and the request is sent again without them
+static bool isNotModifiedUncached(const QNetworkReply *reply) {
+    ResponseCache::Entry cached;
+    return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304
+           && !responseCache.lookup(reply->request().url(), cached);
+}
+
+static QNetworkRequest withoutValidators(QNetworkRequest request) {
+    request.setRawHeader("If-None-Match", QByteArray());
+    request.setRawHeader("If-Modified-Since", QByteArray());
+    return request;
+}
+
+// servers without CBOR keep answering with JSON, so the body format is told by the response itself
+static bool isCbor(const QNetworkReply *reply) {
+    return reply->header(QNetworkRequest::ContentTypeHeader).toString().startsWith("application/cbor");
+}
+
+static void countReply(const QNetworkReply *reply) {
+    // servers list the encodings of request bodies they take in "Accept-Encoding" of their responses (RFC 7694)
+    if (reply->hasRawHeader("Accept-Encoding")) {
+        gzipAccepted = reply->rawHeader("Accept-Encoding").toLower().contains("gzip");
+    }
+    if (reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool()) {
+        ++multiplexedCount;
+    }
+}
+
+static bool isTransient(const QNetworkReply *reply) {
+    auto status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status != 0) { // the server has answered, only overload and gateway statuses are worth repeating
+        return status == 429 || status == 502 || status == 503 || status == 504;
+    }
+    switch (reply->error()) {
+        case QNetworkReply::ConnectionRefusedError:
+        case QNetworkReply::RemoteHostClosedError:
+        case QNetworkReply::TimeoutError:
+        case QNetworkReply::TemporaryNetworkFailureError:
+        case QNetworkReply::NetworkSessionFailedError:
+        case QNetworkReply::UnknownNetworkError:
+            return true;
         default:
-            return QJsonDocument();
+            return false;
     }
-    while (!reply->isFinished()) { // make thread not blocked by waiting for response
-        qApp->processEvents();
+}
+
+static void setIdempotencyKey(QNetworkRequest &request) {
+    // the same key goes with every attempt, so the server creates the entity only once
+    request.setRawHeader("Idempotency-Key", QUuid::createUuid().toByteArray(QUuid::WithoutBraces));
+}
+
+static QString methodName(const QNetworkReply *reply) {
+    switch (reply->operation()) {
+        case QNetworkAccessManager::GetOperation:
+            return "GET";
+        case QNetworkAccessManager::PostOperation:
+            return "POST";
+        case QNetworkAccessManager::PutOperation:
+            return "PUT";
+        case QNetworkAccessManager::DeleteOperation:
+            return "DELETE";
+        default:
+            return "OTHER";
     }
+}
+
+/*!
+ * \brief Time the network phases of a sent request and count its bytes once it is finished
+ * \param reply Reply of the request just sent
+ * \param name Endpoint name
+ */
+static void instrument(QNetworkReply *reply, const QString &name) {
+    QElapsedTimer sent;
+    sent.start();
+    auto headersAt = make_shared<qint64>(-1);
+    auto bytesIn = make_shared<qint64>(0);
+    auto bytesOut = make_shared<qint64>(0);
 
-    QByteArray buffer = reply->readAll();
-    auto json = QJsonDocument::fromJson(buffer);
-    reply->deleteLater();
-    return json;
+    // emitted only for a new connection, a reused one has no handshake to wait for
+    QObject::connect(reply, &QNetworkReply::encrypted, [name, sent] {
+        requestMetrics.record(name, Metrics::Connect, sent.nsecsElapsed());
+    });
+    QObject::connect(reply, &QNetworkReply::metaDataChanged, [name, sent, headersAt] {
+        if (*headersAt < 0) {
+            *headersAt = sent.nsecsElapsed();
+            requestMetrics.record(name, Metrics::FirstByte, *headersAt);
+        }
+    });
+    QObject::connect(reply, &QNetworkReply::uploadProgress, [bytesOut](qint64 bytesSent, qint64) {
+        *bytesOut = bytesSent;
+    });
+    QObject::connect(reply, &QNetworkReply::downloadProgress, [bytesIn](qint64 bytesReceived, qint64) {
+        *bytesIn = bytesReceived;
+    });
+    QObject::connect(reply, &QNetworkReply::finished, [name, sent, headersAt, bytesIn, bytesOut] {
+        if (*headersAt >= 0) {
+            requestMetrics.record(name, Metrics::Transfer, sent.nsecsElapsed() - *headersAt);
+        }
+        requestMetrics.finished(name, *bytesIn, *bytesOut);
+    });
 }
 
-QJsonDocument
-Wrapper::Utils::executeForm(const QUrl &requestUrl, QHttpMultiPart *formData, Wrapper::Utils::RequestType type) {
+static bool isInvalidToken(const ResponseBody &body) {
+    return body.status().error.code == Response::Error::Code::InvalidToken;
+}
+
+static void countResponse(const QString &name, const Response &response) {
+    if (!response.ok) {
+        requestMetrics.failed(name, static_cast<int>(response.error.code));
+    }
+}
+
+/*!
+ * \brief Cache a successful response to revalidate it later
+ * \param reply Finished reply
+ * \param body Response body
+ * \param status Status of the response
+ * \param json Parsed JSON body to keep in memory, null if the body is CBOR or hasn't been parsed whole
+ */
+static void storeResponse(const QNetworkReply *reply, const QByteArray &body, const Response &status,
+                          const QJsonDocument &json) {
+    if (hasValidators(reply) && status.ok) {
+        responseCache.store(reply->request().url(), {reply->rawHeader("ETag"), reply->rawHeader("Last-Modified"),
+                                                     body, isCbor(reply), json});
+    }
+}
+
+void Wrapper::Utils::handleReply(QNetworkReply *reply, const Handler &handler, const Retry &retry) {
+    QObject::connect(reply, &QNetworkReply::finished, [reply, handler, retry] {
+        reply->deleteLater(); // also frees the multipart form data parented to the reply
+        countReply(reply);
+        if (retry && retry(reply)) {
+            return;
+        }
+
+        auto name = endpoint(reply->request().url(), methodName(reply));
+        ResponseCache::Entry cached;
+        if (isNotModified(reply, cached)) {
+            handler(cached.json.isNull() ? ResponseBody(cached.readBody(), cached.cbor) : ResponseBody(cached.json));
+            return;
+        }
+
+        QElapsedTimer parsing;
+        parsing.start();
+        auto data = reply->readAll();
+        ResponseBody body(data, isCbor(reply));
+        requestMetrics.record(name, Metrics::Parse, parsing.nsecsElapsed());
+        countResponse(name, body.status());
+
+        storeResponse(reply, data, body.status(), body.json());
+        handler(body);
+    });
+}
+
+bool Wrapper::Utils::retryIfTransient(const QNetworkReply *reply, int attempt, bool canResend,
+                                      const function<void()> &resend) {
+    auto transient = isTransient(reply);
+    circuitBreaker.record(!transient, options.breakerThreshold);
+    if (!transient || !canResend || attempt >= options.retries) {
+        return false;
+    }
+
+    // capped exponential backoff with jitter, so the clients failed together don't come back together
+    auto delay = qMin(options.maxRetryDelay, options.retryDelay << qMin(attempt, 16));
+    delay = delay / 2 + static_cast<int>(QRandomGenerator::global()->bounded(delay / 2 + 1));
+    bool hasRetryAfter;
+    auto retryAfter = reply->rawHeader("Retry-After").toInt(&hasRetryAfter);
+    if (hasRetryAfter) {
+        delay = qMax(delay, qMin(options.maxRetryDelay, retryAfter * 1000));
+    }
+
+    qDebug() << "Retrying " + reply->request().url().toString() + " in" << delay << "ms";
+    QTimer::singleShot(delay, networkThread->manager, resend);
+    return true;
+}
+
+void Wrapper::Utils::sendWithRetry(const QNetworkRequest &request, const Sender &sender, const Handler &handler,
+                                   int attempt, bool reauthorized, bool canResend) {
+    if (!circuitBreaker.allows(options.breakerCooldown)) {
+        qDebug() << "Server is down, failing " + request.url().toString();
+        handler(ResponseBody());
+        return;
+    }
+
+    auto reply = sender(request);
+    if (!reply) {
+        handler(ResponseBody());
+        return;
+    }
+    instrument(reply, endpoint(request.url(), methodName(reply)));
+
+    auto replyHandler = handler;
+    if (!reauthorized && canResend) {
+        replyHandler = [request, sender, handler](const ResponseBody &body) {
+            if (!isInvalidToken(body)) {
+                handler(body);
+                return;
+            }
+            renewToken(request, [sender, handler](const QNetworkRequest &renewed) {
+                sendWithRetry(renewed, sender, handler, 0, true);
+            }, [handler, body] {
+                handler(body);
+            });
+        };
+    }
+    // a request which can't be sent again ends with the reply it has got, the error included
+    handleReply(reply, replyHandler, [request, sender, handler, attempt, reauthorized, canResend](
+            const QNetworkReply *failed) {
+        if (isNotModifiedUncached(failed)) { // a GET, which can always be sent again
+            sendWithRetry(withoutValidators(request), sender, handler, attempt, reauthorized, canResend);
+            return true;
+        }
+        return retryIfTransient(failed, attempt, canResend, [request, sender, handler, attempt, reauthorized] {
+            sendWithRetry(request, sender, handler, attempt + 1, reauthorized);
+        });
+    });
+}
+
+void Wrapper::Utils::renewToken(const QNetworkRequest &request, const function<void(const QNetworkRequest &)> &replay,
+                                const function<void()> &fail) {
+    // the token is the last part of every user API path
+    auto requestUrl = request.url();
+    auto path = requestUrl.path(QUrl::FullyEncoded);
+    auto sentToken = path.section('/', -1);
+    if (!path.startsWith("/api/user/") || sentToken.isEmpty()) {
+        fail();
+        return;
+    }
+
+    auto resend = [request, requestUrl, path, replay]() mutable {
+        requestUrl.setPath(path.section('/', 0, -2) + "/" + currentUser().accessToken, QUrl::TolerantMode);
+        auto renewed = request;
+        renewed.setUrl(requestUrl);
+        if (renewed.hasRawHeader("Idempotency-Key")) { // the rejected attempt may be remembered by the server
+            setIdempotencyKey(renewed);
+        }
+        replay(renewed);
+    };
+    if (sentToken != currentUser().accessToken) { // already renewed by another request
+        resend();
+        return;
+    }
+    reauthorize([resend, fail](bool ok) mutable {
+        if (ok) {
+            resend();
+        } else {
+            fail();
+        }
+    });
+}
+
+void Wrapper::Utils::reauthorize(const function<void(bool)> &done) {
+    reauthorizing << done;
+    if (reauthorizing.size() > 1) { // the login request is already in flight
+        return;
+    }
+    auto finish = [](bool ok) {
+        for (auto &&waiting : std::exchange(reauthorizing, {})) {
+            waiting(ok);
+        }
+    };
+
+    QString login;
+    QString password;
+    if (!credentials(login, password)) {
+        finish(false);
+        return;
+    }
+    qDebug() << "Access token is rejected, authorizing again";
+
+    QUrlQuery formData;
+    formData.addQueryItem("login", login);
+    formData.addQueryItem("password", password);
+    executeFormAsync(QUrl(serverAddr + "/api/login"), formData, POST, [finish](const ResponseBody &body) {
+        auto userJson = body.value("user").toObject();
+        auto ok = body.status().ok && !userJson["token"].toString().isEmpty();
+        if (ok) {
+            setUser(User(userJson));
+        }
+        finish(ok);
+    });
+}
+
+void Wrapper::Utils::executeAsync(const QUrl &requestUrl, RequestType type, const Handler &handler) {
     qDebug() << "Executing " + requestUrl.toString();
 
-    auto manager = new QNetworkAccessManager;
+    QElapsedTimer queued;
+    queued.start();
+    dispatch([=] {
+        requestMetrics.record(endpoint(requestUrl, type == DELETE ? "DELETE" : "GET"), Metrics::Queue,
+                              queued.nsecsElapsed());
+        auto request = createRequest(requestUrl);
+        auto replyHandler = handler;
+        if (type == GET) {
+            auto &waiting = pendingGets[requestUrl];
+            if (waiting) { // the identical request in flight will answer this one too
+                *waiting << handler;
+                ++coalescedCount;
+                return;
+            }
+            waiting = make_shared<QList<Handler>>();
+            *waiting << handler;
+            replyHandler = [requestUrl, waiters = waiting](const ResponseBody &body) {
+                if (pendingGets.value(requestUrl) == waiters) {
+                    pendingGets.remove(requestUrl);
+                }
+                for (auto &&waitingHandler : *waiters) {
+                    waitingHandler(body);
+                }
+            };
+            addValidators(request);
+        } else {
+            detachReads();
+        }
+        sendWithRetry(request, [type](const QNetworkRequest &request) -> QNetworkReply * {
+            switch (type) {
+                case GET:
+                    return manager()->get(request);
+                case DELETE:
+                    return manager()->deleteResource(request);
+                default:
+                    return nullptr;
+            }
+        }, replyHandler);
+    });
+}
+
+void Wrapper::Utils::executeFormAsync(const QUrl &requestUrl, QHttpMultiPart *formData, RequestType type,
+                                      const Handler &handler) {
+    // a ready form can't be rewound, so it is sent only once
+    auto sent = make_shared<bool>(false);
+    sendForm(requestUrl, [formData, sent]() -> QHttpMultiPart * {
+        if (*sent) {
+            return nullptr;
+        }
+        *sent = true;
+        return formData;
+    }, type, handler, false);
+}
 
-    QNetworkRequest request(requestUrl);
-    request.setSslConfiguration(sslConfiguration);
-    QNetworkReply *reply;
-    switch (type) {
-        case POST:
-            reply = manager->post(request, formData);
-            break;
-        case PUT:
-            reply = manager->put(request, formData);
-            break;
-        default:
-            return QJsonDocument();
+void Wrapper::Utils::executeFormAsync(const QUrl &requestUrl, const FormFactory &generate, RequestType type,
+                                      const Handler &handler) {
+    sendForm(requestUrl, generate, type, handler, true);
+}
+
+void Wrapper::Utils::sendForm(const QUrl &requestUrl, const FormFactory &generate, RequestType type,
+                              const Handler &handler, bool canResend) {
+    qDebug() << "Executing " + requestUrl.toString();
+
+    // the first form is generated by the caller, the repeated attempts generate their own ones in the network
+    // thread; the form will be parented to the reply, so it has to live in the same thread
+    auto pending = make_shared<QHttpMultiPart *>(generate());
+    if (*pending) {
+        (*pending)->moveToThread(executor());
     }
-    while (!reply->isFinished()) { // make thread not blocked by waiting for response
-        qApp->processEvents();
+    QElapsedTimer queued;
+    queued.start();
+    dispatch([=] {
+        requestMetrics.record(endpoint(requestUrl, type == PUT ? "PUT" : "POST"), Metrics::Queue, queued.nsecsElapsed());
+        detachReads();
+        auto request = createRequest(requestUrl);
+        if (type == POST) {
+            setIdempotencyKey(request);
+        }
+        sendWithRetry(request, [type, generate, pending](const QNetworkRequest &request) -> QNetworkReply * {
+            auto formData = *pending ? *pending : generate();
+            *pending = nullptr;
+            if (!formData) {
+                return nullptr;
+            }
+            QNetworkReply *reply;
+            switch (type) {
+                case POST:
+                    reply = manager()->post(request, formData);
+                    break;
+                case PUT:
+                    reply = manager()->put(request, formData);
+                    break;
+                default:
+                    delete formData;
+                    return nullptr;
+            }
+            formData->setParent(reply);
+            return reply;
+        }, [pending, handler](const ResponseBody &body) {
+            delete *pending; // never sent if the server was down
+            *pending = nullptr;
+            handler(body);
+        }, 0, false, canResend);
+    });
+}
+
+void Wrapper::Utils::executeFormAsync(const QUrl &requestUrl, const QUrlQuery &formData, RequestType type,
+                                      const Handler &handler) {
+    qDebug() << "Executing " + requestUrl.toString();
+
+    auto body = formData.toString(QUrl::FullyEncoded).toUtf8();
+    QElapsedTimer queued;
+    queued.start();
+    dispatch([=] {
+        requestMetrics.record(endpoint(requestUrl, type == PUT ? "PUT" : "POST"), Metrics::Queue, queued.nsecsElapsed());
+        detachReads();
+        auto request = createRequest(requestUrl);
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+        if (type == POST) {
+            setIdempotencyKey(request);
+        }
+        sendWithRetry(request, [type, body](const QNetworkRequest &request) -> QNetworkReply * {
+            switch (type) {
+                case POST:
+                    return manager()->post(request, body);
+                case PUT:
+                    return manager()->put(request, body);
+                default:
+                    return nullptr;
+            }
+        }, handler);
+    });
+}
+
+void Wrapper::Utils::executeStreamed(const QUrl &requestUrl, const shared_ptr<StreamDecoder> &decoder,
+                                     const Handler &handler, bool cacheable) {
+    qDebug() << "Executing " + requestUrl.toString();
+
+    QElapsedTimer queued;
+    queued.start();
+    dispatch([=] {
+        requestMetrics.record(endpoint(requestUrl, "GET"), Metrics::Queue, queued.nsecsElapsed());
+        auto &stream = pendingStreams[requestUrl];
+        if (stream && !stream->started()) { // the identical request in flight will stream this one too
+            stream->join(decoder, handler);
+            ++coalescedCount;
+            return;
+        }
+        auto ownStream = make_shared<SharedStream>();
+        ownStream->join(decoder, handler);
+        if (!stream) { // a started stream keeps its place, this request goes on its own
+            stream = ownStream;
+        }
+
+        auto request = createRequest(requestUrl);
+        if (cacheable) {
+            addValidators(request);
+        }
+        streamWithRetry(request, ownStream, [requestUrl, ownStream](const ResponseBody &) {
+            if (pendingStreams.value(requestUrl) == ownStream) {
+                pendingStreams.remove(requestUrl);
+            }
+            ownStream->finish();
+        }, cacheable, 0);
+    });
+}
+
+void Wrapper::Utils::streamWithRetry(const QNetworkRequest &request, const shared_ptr<StreamDecoder> &decoder,
+                                     const Handler &handler, bool cacheable, int attempt, bool reauthorized) {
+    if (!circuitBreaker.allows(options.breakerCooldown)) {
+        qDebug() << "Server is down, failing " + request.url().toString();
+        handler(decoder->skeleton());
+        return;
     }
 
-    QByteArray buffer = reply->readAll();
-    qDebug() << buffer;
-    auto json = QJsonDocument::fromJson(buffer);
-    reply->deleteLater();
-    return json;
+    auto name = endpoint(request.url(), "GET");
+    auto reply = manager()->get(request);
+    reply->setReadBufferSize(streamBufferSize);
+    instrument(reply, name);
+
+    // the raw body is kept only if it is going to be cached, it is cached as it is and decoded again
+    // only when the server answers "not modified"; a large body goes on to a file instead of memory;
+    // the body of a transient failure is dropped, so the decoder stays untouched and the request may be repeated
+    auto body = make_shared<QByteArray>();
+    auto bodyFile = make_shared<shared_ptr<QTemporaryFile>>();
+    auto caching = make_shared<bool>(cacheable);
+    auto fed = make_shared<bool>(false);
+    auto decoding = make_shared<qint64>(0);
+    auto consume = [reply, decoder, body, bodyFile, caching, fed, decoding] {
+        auto chunk = reply->readAll();
+        if (chunk.isEmpty() || isTransient(reply)) {
+            return;
+        }
+        if (*caching && hasValidators(reply)) {
+            if (!*bodyFile && body->size() + chunk.size() > maxBufferedStreamSize) {
+                bodyFile->reset(responseCache.createBodyFile());
+                if (*bodyFile && (*bodyFile)->write(*body) != body->size()) {
+                    bodyFile->reset();
+                }
+                *caching = static_cast<bool>(*bodyFile);
+                *body = QByteArray();
+            }
+            if (!*bodyFile) {
+                body->append(chunk);
+            } else if ((*bodyFile)->write(chunk) != chunk.size()) {
+                bodyFile->reset();
+                *caching = false;
+            }
+        }
+        QElapsedTimer timer;
+        timer.start();
+        if (!*fed && isCbor(reply)) {
+            decoder->useCbor();
+        }
+        decoder->feed(chunk);
+        *decoding += timer.nsecsElapsed();
+        *fed = true;
+    };
+    QObject::connect(reply, &QNetworkReply::readyRead, consume);
+    QObject::connect(reply, &QNetworkReply::finished, [=] {
+        reply->deleteLater();
+        countReply(reply);
+        consume();
+        if (isNotModifiedUncached(reply)) {
+            streamWithRetry(withoutValidators(request), decoder, handler, cacheable, attempt, reauthorized);
+            return;
+        }
+        if (retryIfTransient(reply, attempt, !*fed, [=] {
+            streamWithRetry(request, decoder, handler, cacheable, attempt + 1, reauthorized);
+        })) {
+            return;
+        }
+
+        ResponseCache::Entry cached;
+        if (isNotModified(reply, cached)) {
+            if (cached.cbor) {
+                decoder->useCbor();
+            }
+            if (cached.bodyFile.isEmpty()) {
+                decoder->feed(cached.body);
+            } else { // fed by parts as if it was being received
+                QFile file(cached.bodyFile);
+                file.open(QIODevice::ReadOnly);
+                QByteArray part;
+                while (!(part = file.read(streamBufferSize)).isEmpty()) {
+                    decoder->feed(part);
+                }
+            }
+        }
+        requestMetrics.record(name, Metrics::Parse, *decoding);
+
+        auto skeleton = decoder->skeleton();
+        if (*bodyFile && *caching && hasValidators(reply) && skeleton.status().ok) {
+            (*bodyFile)->setAutoRemove(false); // taken over by the cache
+            (*bodyFile)->close();
+            responseCache.store(reply->request().url(), {reply->rawHeader("ETag"), reply->rawHeader("Last-Modified"),
+                                                         QByteArray(), isCbor(reply), QJsonDocument(),
+                                                         (*bodyFile)->fileName()});
+        } else if (!body->isEmpty()) {
+            storeResponse(reply, *body, skeleton.status(), QJsonDocument());
+        }
+        countResponse(name, skeleton.status());
+        if (!reauthorized && isInvalidToken(skeleton)) {
+            renewToken(request, [=](const QNetworkRequest &renewed) {
+                decoder->reset(); // the rejected response carries nothing but the error
+                streamWithRetry(renewed, decoder, handler, cacheable, 0, true);
+            }, [=] {
+                handler(skeleton);
+            });
+            return;
+        }
+        handler(skeleton);
+    });
+}
+
+ResponseBody Wrapper::Utils::execute(const QUrl &requestUrl, RequestType type) {
+    QFutureInterface<ResponseBody> promise;
+    promise.reportStarted();
+    executeAsync(requestUrl, type, [promise](const ResponseBody &body) {
+        resolve(promise, body);
+    });
+    return await(promise.future());
+}
+
+ResponseBody
+Wrapper::Utils::executeForm(const QUrl &requestUrl, QHttpMultiPart *formData, Wrapper::Utils::RequestType type) {
+    QFutureInterface<ResponseBody> promise;
+    promise.reportStarted();
+    executeFormAsync(requestUrl, formData, type, [promise](const ResponseBody &body) {
+        qDebug() << body.toString();
+        resolve(promise, body);
+    });
+    return await(promise.future());
 }
 
-QJsonDocument
+ResponseBody
 Wrapper::Utils::executeForm(const QUrl &requestUrl, QUrlQuery &formData, Wrapper::Utils::RequestType type) {
-    qDebug() << "Executing " + requestUrl.toString();
+    QFutureInterface<ResponseBody> promise;
+    promise.reportStarted();
+    executeFormAsync(requestUrl, formData, type, [promise](const ResponseBody &body) {
+        qDebug() << body.toString();
+        resolve(promise, body);
+    });
+    return await(promise.future());
+}
 
-    auto manager = new QNetworkAccessManager;
+void Wrapper::Utils::submitAsync(const QUrl &requestUrl, const File *entity, RequestType type,
+                                 const Handler &handler) {
+    executeUploadAsync(requestUrl, entity, -1, type, handler);
+}
 
-    QNetworkRequest request(requestUrl);
-    request.setSslConfiguration(sslConfiguration);
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
-    QNetworkReply *reply;
-    switch (type) {
-        case POST:
-            reply = manager->post(request, formData.toString(QUrl::FullyEncoded).toUtf8());
-            break;
-        case PUT:
-            reply = manager->put(request, formData.toString(QUrl::FullyEncoded).toUtf8());
-            break;
-        default:
-            return QJsonDocument();
+void Wrapper::Utils::submitAsync(const QUrl &requestUrl, const Package *entity, RequestType type,
+                                 const Handler &handler) {
+    executeFormAsync(requestUrl, generateForm(entity, type), type, handler);
+}
+
+void Wrapper::Utils::submitAsync(const QUrl &requestUrl, const Repository *entity, RequestType type,
+                                 const Handler &handler) {
+    executeFormAsync(requestUrl, generateForm(entity, type), type, handler);
+}
+
+QHttpMultiPart *Wrapper::Utils::generateChunkMultipart(int index, const QByteArray &chunk) {
+    auto multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+
+    QHttpPart checksumPart;
+    checksumPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant(R"(form-data; name="checksum")"));
+    checksumPart.setBody(QCryptographicHash::hash(chunk, QCryptographicHash::Sha256).toHex());
+    multiPart->append(checksumPart);
+
+    QHttpPart chunkDataPart;
+    chunkDataPart.setHeader(
+            QNetworkRequest::ContentDispositionHeader,
+            QVariant(QString(R"(form-data; name="upload"; filename="%1")").arg(index))
+    );
+    chunkDataPart.setHeader(QNetworkRequest::ContentTypeHeader, QVariant("application/octet-stream"));
+    chunkDataPart.setBody(chunk);
+    multiPart->append(chunkDataPart);
+
+    return multiPart;
+}
+
+QUrlQuery Wrapper::Utils::generateForm(const Package *pkg, RequestType type) {
+    QUrlQuery formData;
+    if (type == POST) {
+        formData.addQueryItem("id", QString::number(pkg->id));
+    }
+    formData.addQueryItem("name", pkg->name);
+    formData.addQueryItem("repo_id", QString::number(pkg->repository->id));
+    return formData;
+}
+
+QUrlQuery Wrapper::Utils::generateForm(const Repository *repo, RequestType type) {
+    QUrlQuery formData;
+    if (type == POST) {
+        formData.addQueryItem("id", QString::number(repo->id));
+    }
+    formData.addQueryItem("name", repo->name);
+    formData.addQueryItem("url", repo->url);
+    formData.addQueryItem("manager", repo->manager);
+    return formData;
+}
+
+/*!
+ * \brief Gzip the source into the sink
+ * \param source Opened device with the content
+ * \param sink Opened empty device to write the compressed content to, rewound to the start
+ * \param level Compression level
+ * \return Whether the compressed content is ready and smaller than the original one
+ */
+static bool compress(QIODevice *source, QIODevice *sink, int level) {
+    QElapsedTimer timer;
+    timer.start();
+
+    GzipEncoder encoder(level);
+    auto write = [sink](const QByteArray &data) {
+        return sink->write(data) == data.size();
+    };
+    QByteArray chunk;
+    bool ok = !encoder.failed();
+    while (ok && !(chunk = source->read(compressionChunkSize)).isEmpty()) {
+        ok = write(encoder.encode(chunk));
+    }
+    ok = ok && source->atEnd() && write(encoder.finish()) && !encoder.failed() && sink->size() < source->size();
+    compressionTime += static_cast<quint64>(timer.nsecsElapsed() / 1000);
+
+    source->seek(0);
+    sink->seek(0);
+    return ok;
+}
+
+/*!
+ * \struct Wrapper::Utils::Compressed
+ * \brief Compressed content of a file, made once and sent by all the attempts to upload it
+ */
+struct Wrapper::Utils::Compressed {
+    bool tried = false; ///< Whether compression has been tried, its result may be unused
+    QByteArray data; ///< Content compressed in memory
+    QString fileName; ///< Temporary file with the content compressed to disk
+    qint64 size = 0; ///< Size of the original content
+    qint64 sentSize = 0; ///< Size of the content in the last form, compressed or not
+
+    ~Compressed() {
+        if (!fileName.isEmpty()) {
+            QFile::remove(fileName);
+        }
     }
-    while (!reply->isFinished()) { // make thread not blocked by waiting for response
-        qApp->processEvents();
+
+    bool isReady() const {
+        return !data.isEmpty() || !fileName.isEmpty();
     }
+};
 
-    QByteArray buffer = reply->readAll();
-    qDebug() << buffer;
-    auto json = QJsonDocument::fromJson(buffer);
-    reply->deleteLater();
-    return json;
+QHttpMultiPart *Wrapper::Utils::generateMultipart(const File *file, int sourceId) {
+    return generateMultipart(file, sourceId, make_shared<Compressed>());
 }
 
-QHttpMultiPart *Wrapper::Utils::generateMultipart(const File *file) {
+void Wrapper::Utils::executeUploadAsync(const QUrl &requestUrl, const File *file, int sourceId, RequestType type,
+                                        const Handler &handler) {
+    auto compressed = make_shared<Compressed>();
+    executeFormAsync(requestUrl, [file, sourceId, compressed] {
+        return generateMultipart(file, sourceId, compressed);
+    }, type, [compressed, handler](const ResponseBody &body) {
+        // a form is made for every attempt, but the content goes to the server once
+        if (body.status().ok) {
+            contentBytes += static_cast<quint64>(compressed->size);
+            sentContentBytes += static_cast<quint64>(compressed->sentSize);
+        }
+        handler(body);
+    });
+}
+
+QHttpMultiPart *Wrapper::Utils::generateMultipart(const File *file, int sourceId,
+                                                  const shared_ptr<Compressed> &compressed) {
     auto multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
 
     QHttpPart pathPart;
@@ -153,13 +1111,86 @@ QHttpMultiPart *Wrapper::Utils::generateMultipart(const File *file) {
     packageIDPart.setBody(QByteArray::number(file->package->id));
     multiPart->append(packageIDPart);
 
+    if (sourceId != -1) {
+        QHttpPart sourcePart;
+        sourcePart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant(R"(form-data; name="source_id")"));
+        sourcePart.setBody(QByteArray::number(sourceId));
+        multiPart->append(sourcePart);
+        return multiPart;
+    }
+
     QHttpPart fileDataPart;
     fileDataPart.setHeader(
             QNetworkRequest::ContentDispositionHeader,
             QVariant(QString(R"(form-data; name="upload"; filename="%1")").arg(file->name))
     );
     fileDataPart.setHeader(QNetworkRequest::ContentTypeHeader, QVariant("application/octet-stream"));
-    fileDataPart.setBody(file->content);
+    // read by chunks while sending, freed together with the form
+    QIODevice *source;
+    if (file->content.isEmpty()) {
+        source = new QFile(file->getAbsoluteName(), multiPart);
+        if (!source->open(QIODevice::ReadOnly)) { // never send an empty file instead of an unreadable one
+            qDebug() << "Can't read " + file->getAbsoluteName() + ": " + source->errorString();
+            delete multiPart;
+            return nullptr;
+        }
+    } else {
+        auto memorySource = new QBuffer(multiPart);
+        memorySource->setData(file->content);
+        memorySource->open(QIODevice::ReadOnly);
+        source = memorySource;
+    }
+
+    // the first form is made by the caller, so the repeated attempts in the network thread never compress
+    if (!compressed->tried) {
+        compressed->tried = true;
+        compressed->size = source->size();
+        if (options.compressionLevel > 0 && gzipAccepted && compressed->size >= minCompressedSize) {
+            // disk files are compressed to disk as well, so memory usage still doesn't depend on the file size
+            if (file->content.isEmpty()) {
+                QTemporaryFile temporary;
+                temporary.setAutoRemove(false);
+                if (temporary.open() && compress(source, &temporary, options.compressionLevel)) {
+                    compressed->fileName = temporary.fileName();
+                } else if (!temporary.fileName().isEmpty()) {
+                    temporary.remove();
+                }
+            } else {
+                QBuffer buffer(&compressed->data);
+                if (!buffer.open(QIODevice::ReadWrite) || !compress(source, &buffer, options.compressionLevel)) {
+                    buffer.close();
+                    compressed->data.clear();
+                }
+            }
+        }
+    }
+    if (compressed->isReady()) {
+        QIODevice *compressedSource;
+        if (compressed->fileName.isEmpty()) {
+            auto buffer = new QBuffer(multiPart);
+            buffer->setData(compressed->data);
+            compressedSource = buffer;
+        } else {
+            compressedSource = new QFile(compressed->fileName, multiPart);
+        }
+        if (compressedSource->open(QIODevice::ReadOnly)) {
+            // the server decodes the part and verifies the result against the checksum sent above
+            QHttpPart encodingPart;
+            encodingPart.setHeader(QNetworkRequest::ContentDispositionHeader,
+                                   QVariant(R"(form-data; name="content_encoding")"));
+            encodingPart.setBody("gzip");
+            multiPart->append(encodingPart);
+
+            fileDataPart.setRawHeader("Content-Encoding", "gzip");
+            delete source;
+            source = compressedSource;
+        } else {
+            delete compressedSource;
+        }
+    }
+    compressed->sentSize = source->size();
+
+    fileDataPart.setBodyDevice(source);
     multiPart->append(fileDataPart);
 
     return multiPart;
@@ -0,0 +1,104 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Differential test of the base64 codec against QByteArray
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDebug>
+#include <QtCore/QRandomGenerator>
+
+#include "api/utils/Base64Decoder.h"
+#include "api/utils/Base64Encoder.h"
+
+/*!
+ * \brief Decode the text by random parts the way a download is fed to the decoder
+ */
+static QByteArray decodeSplit(const QByteArray &text, QRandomGenerator &random) {
+    Base64Decoder decoder;
+    QByteArray decoded;
+    int pos = 0;
+    while (pos < text.size()) {
+        // tiny parts split the quads, large ones let the kernels run
+        auto size = random.bounded(4) == 0 ? random.bounded(6) : random.bounded(400);
+        size = qMin(size, text.size() - pos);
+        decoded += decoder.decode(text.constData() + pos, size);
+        pos += size;
+    }
+    return decoded;
+}
+
+/*!
+ * \brief Put characters outside the alphabet into the text: line breaks, padding, spaces and 8 bit ones
+ */
+static QByteArray addNoise(const QByteArray &text, QRandomGenerator &random) {
+    static const char noise[] = "\r\n =-_!\x80\xff";
+    auto mode = random.bounded(3);
+    if (mode == 0) {
+        return text;
+    }
+    QByteArray noisy;
+    noisy.reserve(text.size() * 2);
+    for (int i = 0; i < text.size(); ++i) {
+        if (mode == 1 && i > 0 && i % 76 == 0) {
+            noisy += "\r\n";
+        } else if (mode == 2 && random.bounded(40) == 0) {
+            noisy += noise[random.bounded(int(sizeof(noise)) - 1)];
+        }
+        noisy += text[i];
+    }
+    return noisy;
+}
+
+int main() {
+    auto seed = QRandomGenerator::global()->generate();
+    QRandomGenerator random(seed);
+    int failures = 0;
+
+    for (int round = 0; round < 5000; ++round) {
+        auto size = random.bounded(round % 100 == 0 ? 1 << 20 : 4096);
+        QByteArray bytes(size, Qt::Uninitialized);
+        for (auto &byte : bytes) {
+            byte = static_cast<char>(random.bounded(256));
+        }
+
+        auto encoded = Base64Encoder::encode(bytes);
+        if (encoded != bytes.toBase64()) {
+            qWarning() << "Encoding differs, size" << size << "seed" << seed;
+            ++failures;
+        }
+
+        auto text = addNoise(bytes.toBase64(), random);
+        auto decoded = decodeSplit(text, random);
+        if (decoded != QByteArray::fromBase64(text)) {
+            qWarning() << "Decoding differs, size" << size << "seed" << seed;
+            ++failures;
+        }
+    }
+
+    qDebug() << "Base64 codec:" << failures << "failures, seed" << seed;
+    return failures == 0 ? 0 : 1;
+}
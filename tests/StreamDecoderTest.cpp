@@ -0,0 +1,372 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Tests of the stream decoders fed by every possible split of fixed responses
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <functional>
+#include <QtCore/QBuffer>
+#include <QtCore/QByteArray>
+#include <QtCore/QCborArray>
+#include <QtCore/QCborMap>
+#include <QtCore/QDebug>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QScopedPointer>
+
+#include "api/utils/CborReader.h"
+#include "api/utils/StreamDecoder.h"
+
+/*!
+ * \brief Get fixed content bytes covering all the byte values
+ */
+static QByteArray sampleContent(int size) {
+    QByteArray content(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        content[i] = static_cast<char>(i * 7 + 3);
+    }
+    return content;
+}
+
+/*!
+ * \brief Serialize base64 text the way a pretty printing server may do it:
+ * wrapped at 76 characters with escaped line breaks, slashes escaped as well
+ */
+static QByteArray escapeWrapped(const QByteArray &text) {
+    static const char *breaks[] = {"\\n", "\\r\\n", "\\t", "\\f\\b"};
+    QByteArray escaped;
+    for (int i = 0; i < text.size(); ++i) {
+        if (i > 0 && i % 76 == 0) {
+            escaped += breaks[(i / 76) % 4];
+        }
+        if (text[i] == '/') {
+            escaped += "\\/";
+        } else {
+            escaped += text[i];
+        }
+    }
+    return escaped;
+}
+
+/*!
+ * \brief Encode a CBOR item header
+ * \param major Major type
+ * \param value Length or value
+ */
+static QByteArray cborHead(int major, quint64 value) {
+    int size = value < 24 ? 0 : value <= 0xff ? 1 : value <= 0xffff ? 2 : value <= 0xffffffffu ? 4 : 8;
+    int info = size == 0 ? static_cast<int>(value) : size == 1 ? 24 : size == 2 ? 25 : size == 4 ? 26 : 27;
+    QByteArray head(1, static_cast<char>(major << 5 | info));
+    for (int shift = (size - 1) * 8; shift >= 0; shift -= 8) {
+        head.append(static_cast<char>(value >> shift));
+    }
+    return head;
+}
+
+/*!
+ * \brief Encode a string of the given major type in chunks, QCborValue never writes these
+ */
+static QByteArray cborChunked(int major, const QByteArray &data, int chunk) {
+    QByteArray encoded(1, static_cast<char>(major << 5 | 31));
+    for (int pos = 0; pos < data.size(); pos += chunk) {
+        encoded += cborHead(major, static_cast<quint64>(qMin(chunk, data.size() - pos))) + data.mid(pos, chunk);
+    }
+    return encoded + '\xff';
+}
+
+/*!
+ * \brief Encode a map key
+ */
+static QByteArray cborKey(const char *key) {
+    return QCborValue(QString::fromLatin1(key)).toCbor();
+}
+
+/*!
+ * \brief Feed a chunk to a decoder or a bare walker
+ */
+static void feedChunk(StreamDecoder &decoder, const QByteArray &chunk) {
+    decoder.feed(chunk);
+}
+
+static void feedChunk(CborWalker &walker, const QByteArray &chunk) {
+    walker.feed(chunk.constData(), chunk.size());
+}
+
+/*!
+ * \brief Feed a body to a fresh decoder in the given parts
+ * \param make Factory of the decoder
+ * \param body Whole response body
+ * \param splits Positions to split the body at, ascending
+ * \param check Check of the decoder after the body is fed, returns whether it has passed
+ */
+template<class Decoder>
+static bool feedSplit(const std::function<Decoder *()> &make, const QByteArray &body, const QList<int> &splits,
+                      const std::function<bool(Decoder &)> &check) {
+    QScopedPointer<Decoder> decoder(make());
+    int pos = 0;
+    for (auto &&split : splits) {
+        feedChunk(*decoder, body.mid(pos, split - pos));
+        pos = split;
+    }
+    feedChunk(*decoder, body.mid(pos));
+    return check(*decoder);
+}
+
+/*!
+ * \brief Feed a body split at every position into two parts, at every pair of positions into three and byte by byte
+ * \return Number of failed splits
+ */
+template<class Decoder>
+static int feedEverySplit(const char *name, const std::function<Decoder *()> &make, const QByteArray &body,
+                          const std::function<bool(Decoder &)> &check) {
+    int failures = 0;
+    auto fail = [&failures, name](const QList<int> &splits) {
+        if (failures++ < 5) {
+            qWarning() << name << "failed with splits" << splits;
+        }
+    };
+    for (int first = 0; first <= body.size(); ++first) {
+        if (!feedSplit<Decoder>(make, body, {first}, check)) {
+            fail({first});
+        }
+        // a few second splits after every first one cover the parts ending inside escapes and quads
+        for (int second = first + 1; second <= qMin(body.size(), first + 7); ++second) {
+            if (!feedSplit<Decoder>(make, body, {first, second}, check)) {
+                fail({first, second});
+            }
+        }
+    }
+    QList<int> bytes;
+    for (int pos = 1; pos < body.size(); ++pos) {
+        bytes << pos;
+    }
+    if (!feedSplit<Decoder>(make, body, bytes, check)) {
+        fail(bytes.mid(0, 3));
+    }
+    return failures;
+}
+
+/*!
+ * \brief Content decoder on a JSON response with the content escaped and wrapped
+ */
+static int testJsonContent() {
+    auto content = sampleContent(700);
+    // the content endpoint encodes the stored base64 once more
+    auto encoded = escapeWrapped(content.toBase64().toBase64());
+    auto body = "{\n  \"ok\": true,\n  \"file\": {\n    \"id\": 42,\n    \"content\": \"" + encoded
+                + "\"\n  }\n}\n";
+
+    QBuffer sink;
+    std::function<ContentDecoder *()> make = [&sink] {
+        sink.close();
+        sink.setData(QByteArray());
+        sink.open(QIODevice::WriteOnly);
+        return new ContentDecoder(&sink);
+    };
+    std::function<bool(ContentDecoder &)> check = [&sink, &content](ContentDecoder &decoder) {
+        auto skeleton = decoder.skeleton();
+        return !decoder.failed() && sink.data() == content && decoder.written() == content.size()
+               && skeleton.status().ok && skeleton.json().object().value("file").toObject().value("id").toInt() == 42;
+    };
+    return feedEverySplit("JSON content", make, body, check);
+}
+
+/*!
+ * \brief Content decoder on a CBOR response with the content as a byte string, in one piece and in chunks
+ */
+static int testCborContent() {
+    auto content = sampleContent(300);
+    auto whole = QCborValue(QCborMap{{"ok", true}, {"file", QCborMap{{"id", 42}, {"content", content}}}}).toCbor();
+    auto chunked = cborHead(5, 2) + cborKey("ok") + QCborValue(true).toCbor() + cborKey("file") + cborHead(5, 2)
+                   + cborKey("id") + QCborValue(42).toCbor() + cborKey("content") + cborChunked(2, content, 70);
+    // a server may keep the content as base64 text, encoded twice like in JSON
+    auto text = QCborValue(QCborMap{{"ok", true}, {"file", QCborMap{
+            {"id", 42}, {"content", QString::fromLatin1(content.toBase64().toBase64())}}}}).toCbor();
+
+    QBuffer sink;
+    std::function<ContentDecoder *()> make = [&sink] {
+        sink.close();
+        sink.setData(QByteArray());
+        sink.open(QIODevice::WriteOnly);
+        auto decoder = new ContentDecoder(&sink);
+        decoder->useCbor();
+        return decoder;
+    };
+    std::function<bool(ContentDecoder &)> check = [&sink, &content](ContentDecoder &decoder) {
+        auto skeleton = decoder.skeleton();
+        return !decoder.failed() && sink.data() == content && decoder.written() == content.size()
+               && skeleton.status().ok && skeleton.value("file").toObject().value("id").toInt() == 42
+               && skeleton.value("file").toObject().value("content").toString().isEmpty();
+    };
+    return feedEverySplit("CBOR content", make, whole, check)
+           + feedEverySplit("CBOR chunked content", make, chunked, check)
+           + feedEverySplit("CBOR text content", make, text, check);
+}
+
+/*!
+ * \brief List decoder on a JSON response with strings looking like the structure around them
+ */
+static int testJsonList() {
+    QList<QJsonObject> expected;
+    QJsonArray files;
+    for (int id = 1; id <= 4; ++id) {
+        QJsonObject file{{"id", id}, {"path", QString("dir %1/\"quoted\" {braces} [brackets], \\").arg(id)},
+                         {"name", QString::fromUtf8("\xd0\xbf\xd0\xb8\xd0\xbd\xd0\xb3\xd0\xb2\xd0\xb8\xd0\xbd %1").arg(id)},
+                         {"package", QJsonObject{{"id", 7}, {"tags", QJsonArray{"a", "b,c", QJsonArray{}}}}}};
+        expected << file;
+        files << file;
+    }
+    auto body = QJsonDocument(QJsonObject{{"ok", true}, {"files", files}, {"total", 4}}).toJson(QJsonDocument::Indented);
+
+    QList<QJsonObject> received;
+    std::function<ListDecoder *()> make = [&received] {
+        received.clear();
+        return new ListDecoder("files", [&received](const QJsonObject &object) {
+            received << object;
+        }, nullptr);
+    };
+    std::function<bool(ListDecoder &)> check = [&received, &expected](ListDecoder &decoder) {
+        auto skeleton = decoder.skeleton();
+        auto root = skeleton.json().object();
+        return received == expected && skeleton.status().ok && root.value("files").toArray().isEmpty()
+               && root.value("total").toInt() == 4;
+    };
+    return feedEverySplit("JSON list", make, body, check);
+}
+
+/*!
+ * \brief List decoder on a CBOR response of indefinite length with chunked strings, elements read by CborReader
+ * Text chunks hold whole UTF-8 sequences, as the format requires
+ */
+static int testCborList() {
+    struct Entry {
+        qint64 id = 0;
+        QString name;
+        QByteArray content;
+        qint64 created = 0;
+
+        bool operator==(const Entry &other) const {
+            return id == other.id && name == other.name && content == other.content && created == other.created;
+        }
+    };
+
+    QList<Entry> expected;
+    auto body = QByteArray(1, '\xbf') + cborKey("ok") + QCborValue(true).toCbor() + cborKey("files") + '\x9f';
+    for (int id = 1; id <= 3; ++id) {
+        Entry entry{id, QString::fromUtf8("\xd0\xbf\xd0\xb8\xd0\xbd\xd0\xb3\xd0\xb2\xd0\xb8\xd0\xbd %1").arg(id),
+                    sampleContent(30 + id), 1571229296 + id};
+        expected << entry;
+        body += QByteArray(1, '\xbf') + cborKey("id") + QCborValue(entry.id).toCbor()
+                + cborKey("name") + cborChunked(3, entry.name.toUtf8(), 2)
+                + cborKey("content") + cborChunked(2, entry.content, 16)
+                + cborKey("package") + QCborValue(QCborMap{{"id", 7}, {"tags", QCborArray{"a", "b"}}}).toCbor()
+                + cborKey("created") + QCborValue(QCborKnownTags::UnixTime_t, entry.created).toCbor() + '\xff';
+    }
+    body += QByteArray(1, '\xff') + cborKey("total") + QCborValue(3).toCbor() + '\xff';
+
+    QList<Entry> received;
+    std::function<ListDecoder *()> make = [&received] {
+        received.clear();
+        auto decoder = new ListDecoder("files", nullptr, [&received](QCborStreamReader &reader) {
+            Entry entry;
+            CborReader::readMap(reader, [&reader, &entry](const QString &key) {
+                if (key == "id") {
+                    entry.id = CborReader::readInteger(reader);
+                } else if (key == "name") {
+                    entry.name = CborReader::readString(reader);
+                } else if (key == "content") {
+                    entry.content = CborReader::readBytes(reader);
+                } else if (key == "created") {
+                    entry.created = CborReader::readInteger(reader);
+                } else {
+                    reader.next();
+                }
+            });
+            received << entry;
+        });
+        decoder->useCbor();
+        return decoder;
+    };
+    std::function<bool(ListDecoder &)> check = [&received, &expected](ListDecoder &decoder) {
+        auto skeleton = decoder.skeleton();
+        return received == expected && skeleton.status().ok && skeleton.value("files").toArray().isEmpty()
+               && skeleton.value("total").toInt() == 3;
+    };
+    return feedEverySplit("CBOR list", make, body, check);
+}
+
+/*!
+ * \brief CBOR walker splitting both a list and a content string out of a definite length document
+ * The same names deeper in the document are kept in the skeleton
+ */
+static int testCborWalker() {
+    QCborArray files{QCborMap{{"id", 1}, {"path", "a"}},
+                     QCborMap{{"id", 2}, {"package", QCborMap{{"id", 7}}}},
+                     QCborValue(QCborKnownTags::UnixTime_t, 1571229296),
+                     QCborArray{1, QCborArray{}, QCborMap{}}};
+    auto content = sampleContent(100);
+    auto document = QCborMap{{"ok", true}, {"files", files}, {"file", QCborMap{{"id", 3}, {"content", content}}},
+                             {"nested", QCborMap{{"files", QCborArray{4, 5}}, {"deeper", QCborMap{{"content", "kept"}}}}}, {"total", 4}};
+    auto body = QCborValue(document).toCbor();
+
+    auto skeletonDocument = document;
+    skeletonDocument[QString("files")] = QCborArray();
+    skeletonDocument[QString("file")] = QCborMap{{"id", 3}, {"content", QByteArray()}};
+    auto expectedSkeleton = QCborValue(skeletonDocument).toCbor();
+
+    QList<QByteArray> expectedElements;
+    for (const QCborValue file : files) {
+        expectedElements << file.toCbor();
+    }
+
+    QList<QByteArray> elements;
+    QByteArray received;
+    std::function<CborWalker *()> make = [&elements, &received] {
+        elements.clear();
+        received.clear();
+        return new CborWalker("files", [&received](const char *data, int size, bool) {
+            received.append(data, size);
+        }, [&elements](const QByteArray &element) {
+            elements << element;
+        });
+    };
+    std::function<bool(CborWalker &)> check = [&](CborWalker &walker) {
+        return !walker.failed() && walker.skeleton() == expectedSkeleton && elements == expectedElements
+               && received == content;
+    };
+    return feedEverySplit("CBOR walker", make, body, check);
+}
+
+int main() {
+    int failures = 0;
+    failures += testJsonContent();
+    failures += testCborContent();
+    failures += testJsonList();
+    failures += testCborList();
+    failures += testCborWalker();
+
+    qDebug() << "Stream decoders:" << failures << "failures";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,405 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Load generator driving the wrapper sections at a target request rate
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QRandomGenerator>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+
+#include "api/Wrapper.h"
+#include "StandInServer.h"
+
+static const int tickInterval = 10; // milliseconds between the checks for the requests due
+static const int drainTimeout = 30000; // milliseconds to wait for the requests in flight after the run
+
+/*!
+ * \class LoadGenerator
+ * \brief Open loop load of one wrapper section
+ *
+ * Requests are started at the target rate whether the earlier ones have finished or not,
+ * so a slow server shows up in the latencies instead of lowering the rate.
+ * Latencies are measured from the call of the section method until its future is finished
+ * and are counted only for the requests which have succeeded.
+ */
+class LoadGenerator {
+public:
+    /*!
+     * \struct LoadGenerator::Options
+     * \brief Load settings
+     */
+    struct Options {
+        QString section; ///< "files", "pkgs" or "repos"
+        QString operation; ///< "list", "get", "changes", "upload", "content" (files), "configs" (pkgs) or "mixed"
+        double rate; ///< Requests per second
+        int duration; ///< Seconds to start requests for
+        int contentSize; ///< Content size of the uploaded files
+        bool http2; ///< Whether HTTP/2 is offered, reported to compare with HTTP/1.1
+    };
+
+    /*!
+     * \brief Get the operations available for a section
+     * \param section Section name
+     * \return Operations, "mixed" picks one of them except "list" for every request
+     */
+    static QStringList operations(const QString &section);
+
+    explicit LoadGenerator(const Options &options) : options(options), mixed(operations(options.section).mid(1)) {}
+
+    /*!
+     * \brief Get the ids to request and start the load, the application quits after the report is printed
+     * \return Whether the section could be listed
+     */
+    bool start();
+
+private:
+    void tick();
+
+    void issue(const QString &operation);
+
+    template<class Entity>
+    void issue(const QString &operation);
+
+    template<class Entity>
+    Entity *create();
+
+    template<class T>
+    void track(const QFuture<T> &future, const function<bool(const T &)> &succeeded);
+
+    void finish();
+
+    Options options;
+    QStringList mixed;
+    QList<int> ids;
+    QString cursor;
+    QTimer ticker;
+    QElapsedTimer clock;
+    QRandomGenerator random{20190501};
+    qint64 issued = 0;
+    qint64 failed = 0;
+    qint64 outstanding = 0;
+    bool draining = false;
+    bool finished = false;
+    QVector<qint64> latencies; ///< Nanoseconds taken by the succeeded requests
+};
+
+QStringList LoadGenerator::operations(const QString &section) {
+    if (section == "files") {
+        return {"list", "get", "changes", "upload", "content"};
+    } else if (section == "pkgs") {
+        return {"list", "get", "changes", "upload", "configs"};
+    }
+    return {"list", "get", "changes", "upload"};
+}
+
+bool LoadGenerator::start() {
+    auto collect = [this](auto entities) {
+        for (auto &&entity : entities) {
+            ids << entity->id;
+        }
+        qDeleteAll(entities);
+    };
+    if (options.section == "files") {
+        collect(Wrapper::Files::getAll());
+    } else if (options.section == "pkgs") {
+        collect(Wrapper::Packages::getAll());
+    } else {
+        collect(Wrapper::Repositories::getAll());
+    }
+    if (ids.isEmpty()) {
+        return false;
+    }
+
+    QObject::connect(&ticker, &QTimer::timeout, [this] {
+        tick();
+    });
+    clock.start();
+    ticker.start(tickInterval);
+    return true;
+}
+
+void LoadGenerator::tick() {
+    auto elapsed = clock.elapsed();
+    if (elapsed >= options.duration * 1000) {
+        ticker.stop();
+        draining = true;
+        if (outstanding == 0) {
+            finish();
+        } else {
+            QTimer::singleShot(drainTimeout, [this] {
+                finish();
+            });
+        }
+        return;
+    }
+
+    auto due = static_cast<qint64>(elapsed * options.rate / 1000);
+    for (; issued < due; ++issued) {
+        issue(options.operation == "mixed" ? mixed[random.bounded(mixed.size())] : options.operation);
+    }
+}
+
+template<>
+File *LoadGenerator::create<File>() {
+    QByteArray content(options.contentSize, Qt::Uninitialized);
+    for (auto &&byte : content) {
+        byte = static_cast<char>(random.bounded(256));
+    }
+    auto now = QDateTime::currentDateTime();
+    return new File(QString("load-%1.conf").arg(issued), "~/.config/load",
+                    QCryptographicHash::hash(content, QCryptographicHash::Sha256).toHex(), now, now, content);
+}
+
+template<>
+Package *LoadGenerator::create<Package>() {
+    return new Package(QString("load-%1").arg(issued), Repository::Default);
+}
+
+template<>
+Repository *LoadGenerator::create<Repository>() {
+    return new Repository(QString("load-%1").arg(issued), "https://mirror.example.org/load", "apt");
+}
+
+void LoadGenerator::issue(const QString &operation) {
+    if (operation == "content") {
+        track<QByteArray>(Wrapper::Files::getContentAsync(ids[random.bounded(ids.size())]),
+                          [](const QByteArray &content) {
+                              return !content.isEmpty();
+                          });
+    } else if (operation == "configs") {
+        track<QList<File *>>(Wrapper::Packages::getConfigsAsync(ids[random.bounded(ids.size())]),
+                             [](const QList<File *> &configs) {
+                                 qDeleteAll(configs);
+                                 return true; // a failed request has no configs either
+                             });
+    } else if (options.section == "files") {
+        issue<File>(operation);
+    } else if (options.section == "pkgs") {
+        issue<Package>(operation);
+    } else {
+        issue<Repository>(operation);
+    }
+}
+
+template<class Entity>
+void LoadGenerator::issue(const QString &operation) {
+    using Section = Wrapper::Section<Entity>;
+    if (operation == "list") {
+        track<QList<Entity *>>(Section::getAllAsync(), [](const QList<Entity *> &entities) {
+            qDeleteAll(entities);
+            return !entities.isEmpty(); // the listing is only empty if it has failed, the store is never emptied
+        });
+    } else if (operation == "get") {
+        track<Entity *>(Section::getAsync(ids[random.bounded(ids.size())]), [](Entity *const &entity) {
+            auto found = entity != nullptr;
+            delete entity;
+            return found;
+        });
+    } else if (operation == "changes") {
+        track<typename Section::Changes>(Section::getChangesSinceAsync(cursor),
+                                         [this](const typename Section::Changes &changes) {
+                                             for (auto &&list : {changes.created, changes.updated, changes.deleted}) {
+                                                 qDeleteAll(list);
+                                             }
+                                             if (changes.ok) {
+                                                 cursor = changes.cursor;
+                                             }
+                                             return changes.ok;
+                                         });
+    } else {
+        // the entity is read again by the repeated attempts, so it lives until the upload is finished
+        auto entity = create<Entity>();
+        track<int>(Section::uploadAsync(entity), [entity](const int &id) {
+            delete entity;
+            return id != -1;
+        });
+    }
+}
+
+template<class T>
+void LoadGenerator::track(const QFuture<T> &future, const function<bool(const T &)> &succeeded) {
+    QElapsedTimer timer;
+    timer.start();
+    ++outstanding;
+    auto watcher = new QFutureWatcher<T>;
+    QObject::connect(watcher, &QFutureWatcherBase::finished, watcher, [this, watcher, timer, succeeded] {
+        auto elapsed = timer.nsecsElapsed();
+        if (succeeded(watcher->result())) {
+            latencies << elapsed;
+        } else {
+            ++failed;
+        }
+        watcher->deleteLater();
+        if (--outstanding == 0 && draining) {
+            finish();
+        }
+    });
+    watcher->setFuture(future);
+}
+
+void LoadGenerator::finish() {
+    if (finished) {
+        return;
+    }
+    finished = true;
+    auto seconds = clock.nsecsElapsed() / 1e9;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [this](double share) {
+        if (latencies.isEmpty()) {
+            return 0.0;
+        }
+        auto rank = qMax(1, static_cast<int>(std::ceil(share * latencies.size())));
+        return latencies[rank - 1] / 1e6;
+    };
+
+    auto connections = Wrapper::connectionStats();
+    QJsonObject report{
+            {"section", options.section},
+            {"operation", options.operation},
+            {"target_rate", options.rate},
+            {"duration_s", options.duration},
+            {"requests", issued},
+            {"succeeded", latencies.size()},
+            {"failed", failed},
+            {"unfinished", outstanding},
+            {"throughput_rps", latencies.size() / seconds},
+            {"p50_ms", percentile(0.5)},
+            {"p99_ms", percentile(0.99)},
+            {"max_ms", percentile(1)},
+            {"http2", options.http2},
+            {"connections", QJsonObject{
+                    {"requests", static_cast<qint64>(connections.requests)},
+                    {"handshakes", static_cast<qint64>(connections.handshakes)},
+                    {"multiplexed", static_cast<qint64>(connections.multiplexed)},
+                    {"coalesced", static_cast<qint64>(connections.coalesced)}
+            }},
+            {"metrics", Wrapper::metrics().toJson()}
+    };
+    printf("%s\n", QJsonDocument(report).toJson(QJsonDocument::Compact).constData());
+    fflush(stdout);
+    QCoreApplication::quit();
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Load generator for the wrapper, talking to a local server at 127.0.0.1:3000.");
+    parser.addHelpOption();
+    parser.addOptions({
+            {"section", "Section to load: files, pkgs or repos.", "section", "files"},
+            {"operation", "Operation: list, get, changes, upload, content (files), configs (pkgs) "
+                          "or mixed, every one of them but list.", "operation", "mixed"},
+            {"rate", "Requests started per second.", "rate", "100"},
+            {"duration", "Seconds to start requests for.", "seconds", "10"},
+            {"cbor", "Ask for CBOR responses."},
+            {"http2", "Offer HTTP/2, the local cleartext connection falls back to HTTP/1.1 unless --h2c is set."},
+            {"h2c", "Talk HTTP/2 right away, for a server supporting cleartext HTTP/2 (not the stand-in one)."},
+            {"compression", "Gzip level of the uploaded contents, 0 to send them as is.", "level", "0"},
+            {"retries", "Attempts to repeat a request after a transient failure.", "count", "3"},
+            {"cache", "Keep the entity caches of the wrapper, they are turned off by default."},
+            {"serve", "Run the stand-in server in this process, in its own thread."}
+    });
+    StandInServer::addOptions(parser);
+    parser.process(app);
+
+    LoadGenerator::Options options{
+            parser.value("section"),
+            parser.value("operation"),
+            parser.value("rate").toDouble(),
+            parser.value("duration").toInt(),
+            parser.value("content-size").toInt(),
+            parser.isSet("http2") || parser.isSet("h2c")
+    };
+    if (!QStringList{"files", "pkgs", "repos"}.contains(options.section)
+        || !(LoadGenerator::operations(options.section) << "mixed").contains(options.operation)
+        || options.rate <= 0 || options.duration <= 0) {
+        fprintf(stderr, "Unknown section or operation, or a rate or duration not above zero\n");
+        return 1;
+    }
+
+    QThread serverThread;
+    QObject serverContext;
+    StandInServer *server = nullptr;
+    if (parser.isSet("serve")) {
+        serverThread.start();
+        serverContext.moveToThread(&serverThread);
+        auto serverOptions = StandInServer::parseOptions(parser);
+        bool listening = false;
+        QMetaObject::invokeMethod(&serverContext, [&server, &listening, serverOptions] {
+            server = new StandInServer(serverOptions);
+            listening = server->listen();
+        }, Qt::BlockingQueuedConnection);
+        if (!listening) {
+            fprintf(stderr, "Can't listen: %s\n", qPrintable(server->errorString()));
+        }
+    }
+
+    Wrapper::Options wrapperOptions;
+    wrapperOptions.cbor = parser.isSet("cbor");
+    wrapperOptions.http2 = options.http2;
+    wrapperOptions.http2Cleartext = parser.isSet("h2c");
+    wrapperOptions.compressionLevel = parser.value("compression").toInt();
+    wrapperOptions.retries = parser.value("retries").toInt();
+    if (!parser.isSet("cache")) {
+        wrapperOptions.packageCacheTtl = 0;
+        wrapperOptions.repositoryCacheTtl = 0;
+    }
+    Wrapper::init(QSslConfiguration::defaultConfiguration(), true, wrapperOptions);
+
+    auto status = 1;
+    try {
+        Wrapper::authorize(parser.value("login"), parser.value("password"));
+        LoadGenerator generator(options);
+        if (generator.start()) {
+            status = QCoreApplication::exec();
+        } else {
+            fprintf(stderr, "Can't list the section\n");
+        }
+    } catch (const Response::Exception &exception) {
+        fprintf(stderr, "Can't authorize: error %d\n", static_cast<int>(exception.code));
+    }
+
+    if (server) {
+        QMetaObject::invokeMethod(&serverContext, [server] {
+            delete server;
+        }, Qt::BlockingQueuedConnection);
+        serverThread.quit();
+        serverThread.wait();
+    }
+    return status;
+}
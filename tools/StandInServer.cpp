@@ -0,0 +1,786 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Stand-in Antarctica server for load tests without the real one
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <QtCore/QCborArray>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QTimer>
+#include <QtCore/QUrl>
+#include <QtCore/QUrlQuery>
+#include <QtCore/QUuid>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#include <zlib.h>
+
+#include "StandInServer.h"
+#include "api/utils/ResponseBody.h"
+
+using Code = Response::Error::Code;
+
+static const int userId = 1;
+static const qint64 seedTime = 1556668800; // 2019-05-01, creation time of the seeded files
+static const int throttleInterval = 50; // milliseconds between the slices of a throttled response
+static const int maxIdempotentReplies = 100000; // remembered POST answers, forgotten all at once when exceeded
+
+static QString timestamp(qint64 seconds) {
+    return QDateTime::fromSecsSinceEpoch(seconds, Qt::UTC).toString(Qt::ISODate);
+}
+
+static QByteArray reasonPhrase(int status) {
+    switch (status) {
+        case 200:
+            return "OK";
+        case 304:
+            return "Not Modified";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 405:
+            return "Method Not Allowed";
+        case 503:
+            return "Service Unavailable";
+        default:
+            return "Unknown";
+    }
+}
+
+StandInServer::StandInServer(const Options &options) : options(options), server(new QTcpServer), random(20190501) {
+    QObject::connect(server, &QTcpServer::newConnection, server, [this] {
+        accept();
+    });
+
+    static const char *managers[] = {"apt", "pacman", "dnf", "zypper"};
+    for (int i = 0; i < options.repositories; ++i) {
+        auto id = ++lastId;
+        repositories[id] = {
+                QString("repository-%1").arg(id),
+                QString("https://mirror.example.org/repository-%1").arg(id),
+                managers[i % 4]
+        };
+    }
+    auto repositoryIds = repositories.keys();
+    for (int i = 0; i < options.packages; ++i) {
+        auto id = ++lastId;
+        // packages without a repository of their own belong to the predefined default one
+        packages[id] = {
+                QString("package-%1").arg(id),
+                repositoryIds.isEmpty() ? 2 : repositoryIds[i % repositoryIds.size()]
+        };
+    }
+    auto packageIds = packages.keys();
+    for (int i = 0; i < options.files; ++i) {
+        auto id = ++lastId;
+        auto packageId = packageIds.isEmpty() ? 1 : packageIds[i % packageIds.size()];
+        QByteArray content(options.contentSize, Qt::Uninitialized);
+        for (auto &&byte : content) {
+            byte = static_cast<char>(random.bounded(256));
+        }
+        files[id] = {
+                QString("file-%1.conf").arg(id),
+                QString("~/.config/package-%1").arg(packageId),
+                content,
+                QCryptographicHash::hash(content, QCryptographicHash::Sha256).toHex(),
+                seedTime + i,
+                seedTime + i,
+                packageId
+        };
+    }
+}
+
+StandInServer::~StandInServer() {
+    delete server; // the connections are its children
+}
+
+bool StandInServer::listen(const QHostAddress &address, quint16 port) {
+    return server->listen(address, port);
+}
+
+QString StandInServer::errorString() const {
+    return server->errorString();
+}
+
+void StandInServer::addOptions(QCommandLineParser &parser) {
+    Options defaults;
+    parser.addOptions({
+            {"login", "Login of the user.", "login", defaults.login},
+            {"password", "Password of the user.", "password", defaults.password},
+            {"files", "Number of seeded files.", "count", QString::number(defaults.files)},
+            {"packages", "Number of seeded packages.", "count", QString::number(defaults.packages)},
+            {"repositories", "Number of seeded repositories.", "count", QString::number(defaults.repositories)},
+            {"content-size", "Content size of the seeded files in bytes.", "bytes",
+             QString::number(defaults.contentSize)},
+            {"latency", "Delay of every response in milliseconds.", "ms", QString::number(defaults.latency)},
+            {"jitter", "Maximal random delay added to the latency in milliseconds.", "ms",
+             QString::number(defaults.jitter)},
+            {"bandwidth", "Bytes per second every response is sent at, 0 for no limit.", "bytes",
+             QString::number(defaults.bandwidth)},
+            {"error-rate", "Share of requests answered with 503.", "share", QString::number(defaults.errorRate)},
+            {"drop-rate", "Share of requests whose connection is closed.", "share",
+             QString::number(defaults.dropRate)},
+            {"token-ttl", "Seconds an access token is valid for, 0 for no expiration.", "seconds",
+             QString::number(defaults.tokenTtl)},
+            {"json-only", "Answer with JSON even to the clients accepting CBOR."},
+            {"no-gzip", "Don't take gzip request bodies."}
+    });
+}
+
+StandInServer::Options StandInServer::parseOptions(const QCommandLineParser &parser) {
+    Options options;
+    options.login = parser.value("login");
+    options.password = parser.value("password");
+    options.files = parser.value("files").toInt();
+    options.packages = parser.value("packages").toInt();
+    options.repositories = parser.value("repositories").toInt();
+    options.contentSize = parser.value("content-size").toInt();
+    options.latency = parser.value("latency").toInt();
+    options.jitter = parser.value("jitter").toInt();
+    options.bandwidth = parser.value("bandwidth").toLongLong();
+    options.errorRate = parser.value("error-rate").toDouble();
+    options.dropRate = parser.value("drop-rate").toDouble();
+    options.tokenTtl = parser.value("token-ttl").toInt();
+    options.cbor = !parser.isSet("json-only");
+    options.gzipUploads = !parser.isSet("no-gzip");
+    return options;
+}
+
+void StandInServer::accept() {
+    while (auto socket = server->nextPendingConnection()) {
+        QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket] {
+            read(socket);
+        });
+        QObject::connect(socket, &QTcpSocket::disconnected, socket, [this, socket] {
+            buffers.remove(socket);
+            busy.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void StandInServer::read(QTcpSocket *socket) {
+    auto &buffer = buffers[socket];
+    buffer += socket->readAll();
+    while (!busy.contains(socket)) {
+        auto headEnd = buffer.indexOf("\r\n\r\n");
+        if (headEnd == -1) {
+            return;
+        }
+        auto lines = buffer.left(headEnd).split('\n');
+        auto requestLine = lines.takeFirst().trimmed().split(' ');
+        if (requestLine.size() != 3) {
+            socket->abort();
+            return;
+        }
+
+        Request request;
+        request.method = requestLine[0];
+        auto target = requestLine[1];
+        for (auto &&segment : target.left(target.indexOf('?')).split('/')) {
+            if (!segment.isEmpty()) {
+                request.path << QUrl::fromPercentEncoding(segment);
+            }
+        }
+        for (auto &&line : lines) {
+            auto colon = line.indexOf(':');
+            if (colon != -1) {
+                request.headers[line.left(colon).trimmed().toLower()] = line.mid(colon + 1).trimmed();
+            }
+        }
+
+        // the body is either sized or chunked, which the wrapper never does but a command line client may
+        int consumed = headEnd + 4;
+        if (request.headers.value("transfer-encoding").toLower() == "chunked") {
+            forever {
+                auto sizeEnd = buffer.indexOf("\r\n", consumed);
+                if (sizeEnd == -1) {
+                    return;
+                }
+                bool valid;
+                auto size = buffer.mid(consumed, sizeEnd - consumed).split(';').first().trimmed().toInt(&valid, 16);
+                if (!valid) {
+                    socket->abort();
+                    return;
+                }
+                if (buffer.size() < sizeEnd + 2 + size + 2) {
+                    return;
+                }
+                request.body += buffer.mid(sizeEnd + 2, size);
+                consumed = sizeEnd + 2 + size + 2;
+                if (size == 0) {
+                    break;
+                }
+            }
+        } else {
+            auto size = request.headers.value("content-length", "0").toInt();
+            if (buffer.size() < consumed + size) {
+                return;
+            }
+            request.body = buffer.mid(consumed, size);
+            consumed += size;
+        }
+        buffer.remove(0, consumed);
+
+        busy.insert(socket);
+        answer(socket, request);
+        if (!buffers.contains(socket)) { // dropped while answering
+            return;
+        }
+    }
+}
+
+void StandInServer::answer(QTcpSocket *socket, const Request &request) {
+    ++requests;
+    auto roll = random.generateDouble();
+    if (roll < options.dropRate) {
+        socket->abort();
+        return;
+    }
+
+    bool cbor = options.cbor && request.headers.value("accept").contains("application/cbor");
+    Reply reply;
+    auto idempotencyKey = request.method == "POST" ? request.headers.value("idempotency-key") : QByteArray();
+    if (roll < options.dropRate + options.errorRate) {
+        reply = error(Code::OK, "Injected failure", 503);
+    } else if (!idempotencyKey.isEmpty() && idempotent.contains(idempotencyKey)) {
+        reply = idempotent[idempotencyKey];
+    } else {
+        reply = route(request, cbor);
+        if (!idempotencyKey.isEmpty() && reply.status == 200) {
+            if (idempotent.size() >= maxIdempotentReplies) {
+                idempotent.clear();
+            }
+            idempotent[idempotencyKey] = reply;
+        }
+    }
+
+    QByteArray body;
+    QByteArray contentType;
+    if (cbor) {
+        body = QCborValue(reply.document).toCbor();
+        contentType = "application/cbor";
+    } else {
+        body = QJsonDocument(cborToJson(QCborValue(reply.document)).toObject()).toJson(QJsonDocument::Compact);
+        contentType = "application/json";
+    }
+
+    QByteArray head;
+    if (request.method == "GET" && reply.status == 200) {
+        auto etag = '"' + QCryptographicHash::hash(body, QCryptographicHash::Sha1).toHex() + '"';
+        head += "ETag: " + etag + "\r\n";
+        if (request.headers.value("if-none-match") == etag) {
+            reply.status = 304;
+            body.clear();
+        }
+    }
+    if (options.gzipUploads) {
+        head += "Accept-Encoding: gzip\r\n";
+    }
+    if (reply.status != 304) {
+        head += "Content-Type: " + contentType + "\r\n";
+    }
+    head += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    auto close = request.headers.value("connection").toLower() == "close";
+    head += close ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+    auto data = "HTTP/1.1 " + QByteArray::number(reply.status) + " " + reasonPhrase(reply.status) + "\r\n"
+                + head + "\r\n" + body;
+
+    auto delay = options.latency + (options.jitter > 0 ? random.bounded(options.jitter + 1) : 0);
+    if (delay > 0) {
+        QTimer::singleShot(delay, socket, [this, socket, data, close] {
+            send(socket, data, close);
+        });
+    } else {
+        send(socket, data, close);
+    }
+}
+
+void StandInServer::send(QTcpSocket *socket, const QByteArray &data, bool close) {
+    auto slice = qMax<qint64>(1, options.bandwidth * throttleInterval / 1000);
+    if (options.bandwidth <= 0 || data.size() <= slice) {
+        socket->write(data);
+        finish(socket, close);
+        return;
+    }
+    socket->write(data.left(static_cast<int>(slice)));
+    QTimer::singleShot(throttleInterval, socket, [this, socket, rest = data.mid(static_cast<int>(slice)), close] {
+        send(socket, rest, close);
+    });
+}
+
+void StandInServer::finish(QTcpSocket *socket, bool close) {
+    busy.remove(socket);
+    if (close) {
+        socket->disconnectFromHost();
+    } else if (!buffers.value(socket).isEmpty()) {
+        read(socket);
+    }
+}
+
+StandInServer::Reply StandInServer::route(const Request &request, bool cbor) {
+    const auto &path = request.path;
+    if (path.size() == 2 && path[0] == "api" && path[1] == "login") {
+        return request.method == "POST" ? login(request) : error(Code::OK, "Method not allowed", 405);
+    }
+    if (path.size() < 5 || path[0] != "api" || path[1] != "user") {
+        return error(Code::NotFound, "Unknown method", 404);
+    }
+    if (path[2].toInt() != userId || path.last() != token
+        || (options.tokenTtl > 0 && QDateTime::currentSecsSinceEpoch() - tokenIssued > options.tokenTtl)) {
+        return error(Code::InvalidToken, "Invalid or expired token");
+    }
+
+    auto method = path.mid(3, path.size() - 4);
+    static const QStringList prefixes = {"file", "pkg", "repo"};
+    auto section = method[0].endsWith('s') ? method[0].chopped(1) : QString();
+    if (method.size() == 1 && prefixes.contains(section)) {
+        if (request.method == "GET") {
+            return list(section);
+        } else if (request.method == "POST") {
+            return create(request, section);
+        }
+    } else if (method.size() == 3 && prefixes.contains(section) && method[1] == "changes"
+               && request.method == "GET") {
+        return changes(section, method[2]);
+    } else if (method.size() == 2 && method[0] == "file" && method[1] == "uploads" && request.method == "POST") {
+        return startUpload(request);
+    } else if (method.size() >= 3 && method[0] == "file" && method[1] == "upload") {
+        return upload(request, method.mid(2));
+    } else if (method.size() == 3 && method[0] == "file" && method[2] == "content" && request.method == "GET") {
+        return content(method[1].toInt(), cbor);
+    } else if (method.size() == 3 && method[0] == "pkg" && method[2] == "configs" && request.method == "GET") {
+        return configs(method[1].toInt());
+    } else if (method.size() == 2 && prefixes.contains(method[0])) {
+        return entity(request, method[0], method[1].toInt());
+    }
+    return error(Code::NotFound, "Unknown method", 404);
+}
+
+StandInServer::Reply StandInServer::login(const Request &request) {
+    auto form = parseForm(request);
+    if (form.fields.value("login") != options.login.toUtf8()
+        || form.fields.value("password") != options.password.toUtf8()) {
+        return error(Code::WrongLogin, "Wrong login or password");
+    }
+    token = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    tokenIssued = QDateTime::currentSecsSinceEpoch();
+    return ok("user", QCborMap{{"id", userId}, {"login", options.login}, {"name", options.login}, {"token", token}});
+}
+
+StandInServer::Reply StandInServer::list(const QString &prefix) {
+    QCborArray entities;
+    if (prefix == "file") {
+        for (auto it = files.cbegin(); it != files.cend(); ++it) {
+            entities.append(fileMap(it.key(), false));
+        }
+    } else if (prefix == "pkg") {
+        for (auto &&id : packages.keys()) {
+            entities.append(packageMap(id));
+        }
+    } else {
+        for (auto &&id : repositories.keys()) {
+            entities.append(repositoryMap(id));
+        }
+    }
+    return ok(prefix + "s", entities);
+}
+
+StandInServer::Reply StandInServer::entity(const Request &request, const QString &prefix, int id) {
+    if (!exists(prefix, id)) {
+        return error(Code::NotFound, "Record not found");
+    }
+    if (request.method == "GET") {
+        return ok(prefix, prefix == "file" ? fileMap(id, true) : entityMap(prefix, id));
+    } else if (request.method == "PUT") {
+        auto failure = apply(prefix, id, parseForm(request), false);
+        if (!failure.isEmpty()) {
+            return error(Code::FormParsingError, failure);
+        }
+        record(prefix, id, Change::Updated);
+        return ok(prefix, entityMap(prefix, id));
+    } else if (request.method == "DELETE") {
+        auto removed = entityMap(prefix, id);
+        record(prefix, id, Change::Deleted);
+        if (prefix == "file") {
+            files.remove(id);
+        } else if (prefix == "pkg") {
+            packages.remove(id);
+        } else {
+            repositories.remove(id);
+        }
+        return ok(prefix, removed);
+    }
+    return error(Code::OK, "Method not allowed", 405);
+}
+
+StandInServer::Reply StandInServer::create(const Request &request, const QString &prefix) {
+    auto id = lastId + 1;
+    auto failure = apply(prefix, id, parseForm(request), true);
+    if (!failure.isEmpty()) {
+        return error(Code::FormParsingError, failure);
+    }
+    lastId = id;
+    record(prefix, id, Change::Created);
+    return ok("created_id", id);
+}
+
+StandInServer::Reply StandInServer::changes(const QString &prefix, const QString &cursor) {
+    auto &log = history[prefix];
+    QCborArray created, updated, deleted;
+    // the first call gets every entity as created and a cursor to the end of the log
+    if (cursor == "0") {
+        created = list(prefix).document.value(prefix + "s").toArray();
+    } else {
+        bool valid = false;
+        auto position = cursor.startsWith('c') ? cursor.mid(1).toInt(&valid) : -1;
+        if (!valid || position < 0 || position > log.size()) {
+            return error(Code::FormParsingError, "Invalid cursor");
+        }
+
+        // an entity changed several times is reported once, in the state after its last change
+        QMap<int, QPair<Change::Kind, int>> collapsed; // first kind and last change by entity id
+        for (int i = position; i < log.size(); ++i) {
+            auto it = collapsed.find(log[i].id);
+            if (it == collapsed.end()) {
+                collapsed.insert(log[i].id, qMakePair(log[i].kind, i));
+            } else {
+                it->second = i;
+            }
+        }
+        for (auto it = collapsed.cbegin(); it != collapsed.cend(); ++it) {
+            const auto &last = log[it->second];
+            if (last.kind == Change::Deleted) {
+                if (it->first != Change::Created) {
+                    deleted.append(last.entity);
+                }
+            } else if (it->first == Change::Created) {
+                created.append(last.entity);
+            } else {
+                updated.append(last.entity);
+            }
+        }
+    }
+
+    return ok("changes", QCborMap{{"created", created}, {"updated", updated}, {"deleted", deleted},
+                                  {"cursor", QString("c%1").arg(log.size())}});
+}
+
+StandInServer::Reply StandInServer::content(int id, bool cbor) {
+    if (!files.contains(id)) {
+        return error(Code::NotFound, "Record not found");
+    }
+    // this method encodes the JSON content once more, the byte string gets its outer base64 layer from cborToJson()
+    const auto &stored = files[id].content;
+    return ok("file", QCborMap{{"id", id}, {"content", cbor ? stored : stored.toBase64()}});
+}
+
+StandInServer::Reply StandInServer::configs(int packageId) {
+    if (!packages.contains(packageId) && packageId != 1) {
+        return error(Code::NotFound, "Record not found");
+    }
+    QCborArray configs;
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        if (it->packageId == packageId) {
+            configs.append(fileMap(it.key(), true));
+        }
+    }
+    return ok("files", configs);
+}
+
+StandInServer::Reply StandInServer::startUpload(const Request &request) {
+    auto form = parseForm(request);
+    Upload upload;
+    upload.fields = form.fields;
+    upload.size = form.fields.value("size").toLongLong();
+    upload.chunkSize = form.fields.value("chunk_size").toLongLong();
+    if (form.fields.value("name").isEmpty() || upload.size < 0 || upload.chunkSize <= 0) {
+        return error(Code::FormParsingError, "Name, size and chunk size are required");
+    }
+    auto fileId = form.fields.value("file_id").toInt();
+    if (form.fields.contains("file_id") && !files.contains(fileId)) {
+        return error(Code::NotFound, "Record not found");
+    }
+    auto id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    uploads[id] = upload;
+    return ok("upload", QCborMap{{"id", id}, {"received", QCborArray()}});
+}
+
+StandInServer::Reply StandInServer::upload(const Request &request, const QStringList &path) {
+    auto it = uploads.find(path[0]);
+    if (it == uploads.end()) {
+        return error(Code::NotFound, "Upload not found");
+    }
+    auto &upload = *it;
+
+    if (path.size() == 3 && path[1] == "chunk" && request.method == "PUT") {
+        auto form = parseForm(request);
+        auto chunk = form.fields.value("upload");
+        if (QCryptographicHash::hash(chunk, QCryptographicHash::Sha256).toHex() != form.fields.value("checksum")) {
+            return error(Code::FormParsingError, "Chunk checksum mismatch");
+        }
+        upload.chunks[path[2].toInt()] = chunk;
+    } else if (path.size() == 2 && path[1] == "complete" && request.method == "POST") {
+        auto count = qMax<qint64>(1, (upload.size + upload.chunkSize - 1) / upload.chunkSize);
+        QByteArray content;
+        for (int index = 0; index < count; ++index) {
+            if (!upload.chunks.contains(index)) {
+                return error(Code::FormParsingError, QString("Chunk %1 is missing").arg(index));
+            }
+            content += upload.chunks[index];
+        }
+        if (content.size() != upload.size) {
+            return error(Code::FormParsingError, "Size mismatch");
+        }
+
+        Form form;
+        form.fields = upload.fields;
+        form.fields["upload"] = content;
+        auto update = form.fields.contains("file_id");
+        auto id = update ? form.fields.value("file_id").toInt() : lastId + 1;
+        if (update && !files.contains(id)) {
+            return error(Code::NotFound, "Record not found");
+        }
+        auto failure = apply("file", id, form, !update);
+        if (!failure.isEmpty()) {
+            return error(Code::FormParsingError, failure);
+        }
+        if (!update) {
+            lastId = id;
+        }
+        record("file", id, update ? Change::Updated : Change::Created);
+        uploads.erase(it);
+        return ok("created_id", id);
+    } else if (path.size() != 1 || request.method != "GET") {
+        return error(Code::NotFound, "Unknown method", 404);
+    }
+
+    QCborArray received;
+    for (auto &&index : upload.chunks.keys()) {
+        received.append(index);
+    }
+    return ok("upload", QCborMap{{"id", path[0]}, {"received", received}});
+}
+
+QString StandInServer::apply(const QString &prefix, int id, const Form &form, bool created) {
+    const auto &fields = form.fields;
+    if (prefix == "repo") {
+        if (fields.value("name").isEmpty()) {
+            return "Name is required";
+        }
+        repositories[id] = {
+                QString::fromUtf8(fields.value("name")),
+                QString::fromUtf8(fields.value("url")),
+                QString::fromUtf8(fields.value("manager"))
+        };
+    } else if (prefix == "pkg") {
+        auto repositoryId = fields.value("repo_id").toInt();
+        if (fields.value("name").isEmpty() || repositoryId < 1 || (repositoryId > 2 && !repositories.contains(repositoryId))) {
+            return "Name and an existing repository are required";
+        }
+        packages[id] = {QString::fromUtf8(fields.value("name")), repositoryId};
+    } else {
+        auto packageId = fields.value("package_id").toInt();
+        if (packageId != 1 && !packages.contains(packageId)) {
+            return "Package not found";
+        }
+        StoredFile file = created ? StoredFile() : files[id];
+        if (fields.contains("source_id")) { // the content is already at the server
+            auto sourceId = fields.value("source_id").toInt();
+            if (!files.contains(sourceId)) {
+                return "Source file not found";
+            }
+            file.content = files[sourceId].content;
+            if (file.name.isEmpty()) {
+                file.name = files[sourceId].name;
+            }
+        } else if (fields.contains("upload")) {
+            file.content = fields.value("content_encoding") == "gzip"
+                           ? gunzip(fields.value("upload"))
+                           : fields.value("upload");
+            if (file.content.isNull()) {
+                return "Malformed gzip content";
+            }
+        } else {
+            return "Content is required";
+        }
+        if (fields.contains("name")) {
+            file.name = QString::fromUtf8(fields.value("name"));
+        } else if (!form.fileNames.value("upload").isEmpty()) {
+            file.name = form.fileNames.value("upload");
+        }
+        if (file.name.isEmpty()) {
+            return "Name is required";
+        }
+        file.path = QString::fromUtf8(fields.value("path"));
+        file.checksum = fields.value("checksum");
+        file.created = fields.value("created").toLongLong();
+        file.modified = fields.value("modified").toLongLong();
+        file.packageId = packageId;
+        files[id] = file;
+    }
+    return QString();
+}
+
+QCborMap StandInServer::repositoryMap(int id) const {
+    if (id == 1 || id == 2) { // the predefined "no repository" and default one
+        return {{"id", id}, {"name", id == 2 ? "Default" : ""}, {"url", ""}, {"manager", ""}};
+    }
+    const auto &repository = repositories[id];
+    return {{"id", id}, {"name", repository.name}, {"url", repository.url}, {"manager", repository.manager}};
+}
+
+QCborMap StandInServer::packageMap(int id) const {
+    if (id == 1) { // the predefined default package
+        return {{"id", id}, {"name", ""}, {"repository", repositoryMap(1)}};
+    }
+    const auto &package = packages[id];
+    return {{"id", id}, {"name", package.name}, {"repository", repositoryMap(package.repositoryId)}};
+}
+
+QCborMap StandInServer::fileMap(int id, bool content) const {
+    const auto &file = files[id];
+    QCborMap map{{"id", id}, {"name", file.name}, {"path", file.path}, {"checksum", QString::fromUtf8(file.checksum)},
+                 {"created", timestamp(file.created)}, {"modified", timestamp(file.modified)},
+                 {"package", packageMap(file.packageId)}};
+    if (content) {
+        map.insert(QString("content"), file.content);
+    }
+    return map;
+}
+
+QCborMap StandInServer::entityMap(const QString &prefix, int id) const {
+    if (prefix == "file") {
+        return fileMap(id, false);
+    } else if (prefix == "pkg") {
+        return packageMap(id);
+    }
+    return repositoryMap(id);
+}
+
+bool StandInServer::exists(const QString &prefix, int id) const {
+    if (prefix == "file") {
+        return files.contains(id);
+    } else if (prefix == "pkg") {
+        return packages.contains(id);
+    }
+    return repositories.contains(id);
+}
+
+void StandInServer::record(const QString &prefix, int id, Change::Kind kind) {
+    history[prefix].append({id, kind, entityMap(prefix, id)});
+}
+
+StandInServer::Reply StandInServer::error(Code code, const QString &text, int status) {
+    Reply reply;
+    reply.status = status;
+    reply.document = {{"ok", false}, {"error", QCborMap{{"code", static_cast<int>(code)}, {"text", text}}}};
+    return reply;
+}
+
+StandInServer::Reply StandInServer::ok(const QString &key, const QCborValue &value) {
+    Reply reply;
+    reply.document = {{"ok", true}, {key, value}};
+    return reply;
+}
+
+StandInServer::Form StandInServer::parseForm(const Request &request) {
+    Form form;
+    auto contentType = request.headers.value("content-type");
+    if (!contentType.startsWith("multipart/form-data")) {
+        for (auto &&item : QUrlQuery(QString::fromUtf8(request.body)).queryItems(QUrl::FullyDecoded)) {
+            form.fields[item.first] = item.second.toUtf8();
+        }
+        return form;
+    }
+
+    auto boundary = contentType.mid(contentType.indexOf("boundary=") + 9).split(';').first().trimmed();
+    if (boundary.startsWith('"') && boundary.endsWith('"')) {
+        boundary = boundary.mid(1, boundary.size() - 2);
+    }
+    auto delimiter = "--" + boundary;
+    const auto &body = request.body;
+    auto start = body.indexOf(delimiter);
+    while (start != -1) {
+        start += delimiter.size();
+        if (body.mid(start, 2) == "--") { // the closing delimiter
+            break;
+        }
+        auto headEnd = body.indexOf("\r\n\r\n", start);
+        auto end = body.indexOf("\r\n" + delimiter, start);
+        if (headEnd == -1 || end == -1 || headEnd > end) {
+            break;
+        }
+
+        QString name, fileName;
+        for (auto &&line : body.mid(start, headEnd - start).split('\n')) {
+            if (!line.trimmed().toLower().startsWith("content-disposition:")) {
+                continue;
+            }
+            for (auto &&parameter : line.split(';')) {
+                auto trimmed = parameter.trimmed();
+                auto value = QString::fromUtf8(trimmed.mid(trimmed.indexOf('=') + 1)).remove('"');
+                if (trimmed.startsWith("name=")) {
+                    name = value;
+                } else if (trimmed.startsWith("filename=")) {
+                    fileName = value;
+                }
+            }
+        }
+        form.fields[name] = body.mid(headEnd + 4, end - headEnd - 4);
+        if (!fileName.isEmpty()) {
+            form.fileNames[name] = fileName;
+        }
+        start = end + 2;
+    }
+    return form;
+}
+
+QByteArray StandInServer::gunzip(const QByteArray &data) {
+    z_stream stream{};
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        return QByteArray();
+    }
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = static_cast<uInt>(data.size());
+
+    QByteArray result("");
+    char buffer[64 * 1024];
+    int status;
+    do {
+        stream.next_out = reinterpret_cast<Bytef *>(buffer);
+        stream.avail_out = sizeof(buffer);
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) {
+            inflateEnd(&stream);
+            return QByteArray();
+        }
+        result.append(buffer, static_cast<int>(sizeof(buffer) - stream.avail_out));
+    } while (status != Z_STREAM_END);
+    inflateEnd(&stream);
+    return result;
+}
@@ -0,0 +1,249 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Stand-in Antarctica server for load tests without the real one
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANTARCTICA_STANDINSERVER_H
+#define ANTARCTICA_STANDINSERVER_H
+
+
+#include <QtCore/QCborMap>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QRandomGenerator>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtNetwork/QHostAddress>
+
+#include "api/models/Response.hpp"
+
+class QTcpServer;
+class QTcpSocket;
+
+/*!
+ * \class StandInServer
+ * \brief HTTP/1.1 server answering the API requests of the wrapper from an in-memory store
+ *
+ * Implements login, the files, packages and repositories sections with their changes, file contents,
+ * package configs and chunked uploads. Responses are CBOR for clients accepting it and JSON otherwise,
+ * GET responses carry an ETag to revalidate them and POST requests are deduplicated by their Idempotency-Key.
+ * Latency, bandwidth and failures are injected as configured. The server lives in the thread it is created in
+ * and needs an event loop there.
+ */
+class StandInServer {
+public:
+    /*!
+     * \struct StandInServer::Options
+     * \brief Store contents and injected network conditions
+     */
+    struct Options {
+        QString login = "penguin"; ///< Login of the only user
+        QString password = "penguin"; ///< Password of the only user
+        int files = 1000; ///< Number of files the store is seeded with
+        int packages = 100; ///< Number of packages the store is seeded with
+        int repositories = 10; ///< Number of repositories the store is seeded with
+        int contentSize = 1024; ///< Content size of the seeded files
+        int latency = 0; ///< Milliseconds every response is delayed by
+        int jitter = 0; ///< Maximal random milliseconds added to the latency
+        qint64 bandwidth = 0; ///< Bytes per second every response is sent at, 0 for no limit
+        double errorRate = 0; ///< Share of requests answered with "503 Service Unavailable"
+        double dropRate = 0; ///< Share of requests whose connection is closed without an answer
+        int tokenTtl = 0; ///< Seconds an access token is valid for, 0 for no expiration
+        bool cbor = true; ///< Answer with CBOR to the clients accepting it
+        bool gzipUploads = true; ///< Tell the clients that gzip request bodies are taken
+    };
+
+    /*!
+     * \brief Constructor seeding the store
+     * \param options Store contents and network conditions
+     */
+    explicit StandInServer(const Options &options = Options());
+
+    ~StandInServer();
+
+    /*!
+     * \brief Start accepting connections
+     * \param address Address to listen on
+     * \param port Port to listen on, 3000 is the one Wrapper::init() uses for a local server
+     * \return Whether the server is listening
+     */
+    bool listen(const QHostAddress &address = QHostAddress::LocalHost, quint16 port = 3000);
+
+    /*!
+     * \brief Get the error of the last listen() call
+     */
+    QString errorString() const;
+
+    /*!
+     * \brief Get the number of requests answered so far
+     */
+    inline quint64 answered() const {
+        return requests;
+    }
+
+    /*!
+     * \brief Add the command line options describing Options to a parser
+     * \param parser Command line parser
+     */
+    static void addOptions(QCommandLineParser &parser);
+
+    /*!
+     * \brief Read Options from a parser the options are added to by addOptions()
+     * \param parser Command line parser having processed the arguments
+     * \return Options, the defaults for the ones not given
+     */
+    static Options parseOptions(const QCommandLineParser &parser);
+
+private:
+    struct Request {
+        QByteArray method;
+        QStringList path; ///< Decoded path segments
+        QHash<QByteArray, QByteArray> headers; ///< Headers by their lowercase names
+        QByteArray body;
+    };
+
+    struct Form {
+        QHash<QString, QByteArray> fields;
+        QHash<QString, QString> fileNames; ///< File names of the multipart fields by their names
+    };
+
+    struct Reply {
+        int status = 200;
+        QCborMap document; ///< Response document, byte strings become base64 text in JSON
+    };
+
+    struct StoredRepository {
+        QString name;
+        QString url;
+        QString manager;
+    };
+
+    struct StoredPackage {
+        QString name;
+        int repositoryId;
+    };
+
+    struct StoredFile {
+        QString name;
+        QString path;
+        QByteArray content;
+        QByteArray checksum;
+        qint64 created;
+        qint64 modified;
+        int packageId;
+    };
+
+    struct Change {
+        enum Kind {
+            Created, Updated, Deleted
+        };
+
+        int id;
+        Kind kind;
+        QCborMap entity; ///< Entity as it was after the change, without the file content
+    };
+
+    struct Upload {
+        QHash<QString, QByteArray> fields; ///< Form the upload was started with
+        qint64 size;
+        qint64 chunkSize;
+        QMap<int, QByteArray> chunks;
+    };
+
+    void accept();
+
+    void read(QTcpSocket *socket);
+
+    void answer(QTcpSocket *socket, const Request &request);
+
+    void send(QTcpSocket *socket, const QByteArray &data, bool close);
+
+    void finish(QTcpSocket *socket, bool close);
+
+    Reply route(const Request &request, bool cbor);
+
+    Reply login(const Request &request);
+
+    Reply list(const QString &prefix);
+
+    Reply entity(const Request &request, const QString &prefix, int id);
+
+    Reply create(const Request &request, const QString &prefix);
+
+    Reply changes(const QString &prefix, const QString &cursor);
+
+    Reply content(int id, bool cbor);
+
+    Reply configs(int packageId);
+
+    Reply startUpload(const Request &request);
+
+    Reply upload(const Request &request, const QStringList &path);
+
+    QString apply(const QString &prefix, int id, const Form &form, bool created);
+
+    QCborMap repositoryMap(int id) const;
+
+    QCborMap packageMap(int id) const;
+
+    QCborMap fileMap(int id, bool content) const;
+
+    QCborMap entityMap(const QString &prefix, int id) const;
+
+    bool exists(const QString &prefix, int id) const;
+
+    void record(const QString &prefix, int id, Change::Kind kind);
+
+    static Reply error(Response::Error::Code code, const QString &text, int status = 200);
+
+    static Reply ok(const QString &key, const QCborValue &value);
+
+    static Form parseForm(const Request &request);
+
+    static QByteArray gunzip(const QByteArray &data);
+
+    Options options;
+    QTcpServer *server;
+    QRandomGenerator random;
+    quint64 requests = 0;
+    QHash<QTcpSocket *, QByteArray> buffers; ///< Received bytes not parsed yet by connections
+    QSet<QTcpSocket *> busy; ///< Connections waiting for an answer, the next request is read after it is sent
+
+    QString token;
+    qint64 tokenIssued = 0;
+    int lastId = 2; ///< Ids 1 and 2 belong to the predefined entities
+    QMap<int, StoredRepository> repositories;
+    QMap<int, StoredPackage> packages;
+    QMap<int, StoredFile> files;
+    QHash<QString, QVector<Change>> history; ///< Changes by entity prefix, a cursor is a position in the list
+    QHash<QString, Upload> uploads;
+    QHash<QByteArray, Reply> idempotent; ///< Answers to POST requests by their Idempotency-Key
+};
+
+
+#endif //ANTARCTICA_STANDINSERVER_H
@@ -0,0 +1,55 @@
+/*!
+ * \file
+ * \author Nikita Mironov <nickfrom22nd@gmail.com>
+ * \brief Command line entry of the stand-in server
+ *
+ * \section LICENSE
+ *
+ * Copyright (c) 2019 Penguins of Madagascar
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+
+#include "StandInServer.h"
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Stand-in Antarctica server for the load tests of the wrapper.");
+    parser.addHelpOption();
+    parser.addOptions({
+            {"address", "Address to listen on.", "address", "127.0.0.1"},
+            {"port", "Port to listen on, the one of a local server in Wrapper::init() by default.", "port", "3000"}
+    });
+    StandInServer::addOptions(parser);
+    parser.process(app);
+
+    StandInServer server(StandInServer::parseOptions(parser));
+    if (!server.listen(QHostAddress(parser.value("address")), static_cast<quint16>(parser.value("port").toUInt()))) {
+        fprintf(stderr, "Can't listen: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+    fprintf(stderr, "Listening on %s:%s\n", qPrintable(parser.value("address")), qPrintable(parser.value("port")));
+    return QCoreApplication::exec();
+}